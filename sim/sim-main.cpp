@@ -82,6 +82,31 @@ size_t recorder_render_object(intptr_t tracing,
 }
 
 
+static void memory_statistics()
+// ----------------------------------------------------------------------------
+//   Print memory management counters and heaviest allocating commands
+// ----------------------------------------------------------------------------
+{
+    const runtime::statistics &stats = rt.stats();
+    fprintf(stderr,
+            "Memory statistics:\n"
+            "  Allocated   %zu bytes\n"
+            "  Recycled    %zu bytes\n"
+            "  Moved       %zu bytes\n"
+            "  Collections %u in %u ms\n",
+            stats.allocated, stats.recycled, stats.moved,
+            stats.collections, stats.gc_time);
+
+    const runtime::attribution *table = rt.attributions();
+    for (uint i = 0; i < runtime::ATTRIBUTIONS; i++)
+        if (table[i].calls)
+            fprintf(stderr, "  %-20s %10zu bytes %6u GC %8u calls\n",
+                    cstring(object::name(object::id(table[i].type))),
+                    table[i].allocated, table[i].collections,
+                    table[i].calls);
+}
+
+
 // Ensure linker keeps debug code
 extern cstring debug();
 
@@ -146,6 +171,9 @@ int main(int argc, char *argv[])
             case 'k':
                 db48x_keyboard = true;
                 break;
+            case 'M':
+                atexit(memory_statistics);
+                break;
             case 'w':
                 if (argv[a][2])
                     wait_time = atoi(argv[a]+2);
@@ -1218,7 +1218,7 @@ algebraic_p arithmetic::evaluate(id          op,
                 {
                     if (based)
                         xv &= (1UL << ws) - 1UL;
-                    return rt.make<integer>(xt, xv);
+                    return integer::make(xt, xv);
                 }
             }
         }
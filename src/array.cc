@@ -29,7 +29,11 @@
 
 #include "array.h"
 #include "arithmetic.h"
+#include "decimal.h"
 #include "functions.h"
+#include "integer.h"
+
+#include <stdlib.h>
 
 
 RECORDER(matrix, 16, "Determinant computation");
@@ -381,6 +385,831 @@ static algebraic_g matrix_mul(size_t r, size_t c,
 
 
 
+// ============================================================================
+//
+//    Dense real matrices
+//
+// ============================================================================
+//
+//   When all elements of the matrices are real numbers and at least one of
+//   them is a decimal, the result is a decimal matrix. In that case, elements
+//   are copied into a contiguous block in the scratchpad, with a packed
+//   base-1000 mantissa per element, and LU decomposition, inversion and
+//   products run in place without allocating objects. Results are converted
+//   back to decimal objects at the end. Exact and symbolic matrices use the
+//   generic code above and below, which operates on objects on the stack.
+//
+//   The scratchpad moves when temporaries are allocated or garbage is
+//   collected, so the block is addressed relative to rt.scratchpad(), and
+//   bind() must be called after anything that may allocate. The scratchpad
+//   does not move by a multiple of the alignment of elements, so bind() also
+//   realigns the data inside the block if necessary. Elements of results
+//   are built directly in the scratchpad, so that this only happens once
+//   per row.
+
+struct dense
+// ----------------------------------------------------------------------------
+//   A dense matrix of reals with packed mantissas
+// ----------------------------------------------------------------------------
+//   A value is 0.m[0]m[1]...m[prec-1] * 1000^exp, with m[0] non-zero unless
+//   the value is zero. GUARD kigits are kept beyond the current precision,
+//   and removed by rounding when converting back to decimal. A subtraction
+//   that cancels at least as many digits as the current precision leaves
+//   only rounding noise from the guard kigits, and is flushed to zero.
+{
+    typedef decimal::kint kint;
+    enum { GUARD = 3, SCRATCH = 2, ALIGN = 8 };
+
+    struct real
+    {
+        large   exp;            // Exponent, power of 1000
+        bool    neg;            // Sign
+    };
+
+    dense(size_t rows, size_t cols, size_t temps = 0);
+    ~dense();
+    operator bool() const               { return data; }
+    void        bind();
+
+    real *at(size_t i) const            { return (real *) (data + i*stride); }
+    real *at(size_t r, size_t c) const  { return at(r * cols + c); }
+    real *temp(size_t t) const          { return at(rows * cols + t); }
+    real *scratch(size_t s) const       { return temp(temps + s); }
+    static kint *m(real *x)             { return (kint *) (x + 1); }
+    static bool is_zero(real *x)        { return m(x)[0] == 0; }
+
+    bool        load(array_r a, bool vector = false);
+    bool        load(size_t i, object_p obj);
+    void        zero(real *x);
+    void        one(real *x);
+    void        copy(real *x, real *y)  { memcpy(x, y, stride); }
+    void        fma(real *r, real *x, real *y, bool sub = false);
+    int         compare(real *x, real *y);
+    void        reciprocal(real *r, real *x);
+    void        divide(real *q, real *x, real *y, real *recip);
+    bool        lu(bool *neg);
+    void        solve(dense *b, dense &x);
+    bool        round(real *x, large &exp, size_t &nkigits);
+    algebraic_p store(size_t i);
+    bool        append(size_t i);
+    array_p     store(bool vector = false);
+
+    size_t      rows, cols, temps, digits, prec, stride;
+    size_t      size;           // Size of the data
+    size_t      base;           // Offset of the block in the scratchpad
+    size_t      skew;           // Offset of the aligned data in the block
+    size_t     *perm;           // Original row of each row after LU
+    uint32_t   *prod;           // Exact product, 2 * prec kigits
+    kint       *wx, *wy;        // Aligned operands, 2 * prec + 2 kigits
+    byte       *data;
+};
+
+
+dense::dense(size_t rows, size_t cols, size_t temps)
+// ----------------------------------------------------------------------------
+//   Allocate a dense matrix at the current precision in the scratchpad
+// ----------------------------------------------------------------------------
+//   If we run out of memory, the generic code reports the error
+    : rows(rows), cols(cols), temps(temps),
+      digits(Settings.Precision()),
+      prec((digits + 2) / 3 + GUARD),
+      stride(sizeof(real) + (prec * sizeof(kint) + 7) / 8 * 8),
+      size((rows * cols + temps + SCRATCH) * stride
+           + rows * sizeof(size_t)
+           + 2 * prec * sizeof(uint32_t)
+           + 2 * (2 * prec + 2) * sizeof(kint)),
+      base(rt.allocated()), skew(),
+      perm(), prod(), wx(), wy(), data()
+{
+    byte *block = rt.allocate(size + ALIGN - 1);
+    if (!block)
+    {
+        rt.clear_error();
+        return;
+    }
+    skew = (ALIGN - uintptr_t(block) % ALIGN) % ALIGN;
+    data = block + skew;
+    bind();
+    record(matrix, "Dense %ux%u matrix with %u kigits at %p",
+           rows, cols, prec, data);
+}
+
+
+dense::~dense()
+// ----------------------------------------------------------------------------
+//   Release the scratchpad space
+// ----------------------------------------------------------------------------
+//   Dense matrices are released in the reverse order of their allocation
+{
+    if (data)
+        rt.free(size + ALIGN - 1);
+}
+
+
+void dense::bind()
+// ----------------------------------------------------------------------------
+//   Compute the addresses in the scratchpad, realigning data if necessary
+// ----------------------------------------------------------------------------
+{
+    if (!data)
+        return;
+    byte   *block = rt.scratchpad() - rt.allocated() + base;
+    size_t  align = (ALIGN - uintptr_t(block) % ALIGN) % ALIGN;
+    if (align != skew)
+    {
+        record(matrix, "Realign dense matrix from %u to %u", skew, align);
+        memmove(block + align, block + skew, size);
+    }
+    skew = align;
+    data = block + skew;
+
+    size_t elems = rows * cols + temps + SCRATCH;
+    perm = (size_t *) (data + elems * stride);
+    prod = (uint32_t *) (perm + rows);
+    wx   = (kint *) (prod + 2 * prec);
+    wy   = wx + 2 * prec + 2;
+}
+
+
+void dense::zero(real *x)
+// ----------------------------------------------------------------------------
+//   Set an element to zero
+// ----------------------------------------------------------------------------
+{
+    memset(x, 0, stride);
+}
+
+
+void dense::one(real *x)
+// ----------------------------------------------------------------------------
+//   Set an element to one, i.e. 0.001 * 1000^1
+// ----------------------------------------------------------------------------
+{
+    zero(x);
+    m(x)[0] = 1;
+    x->exp = 1;
+}
+
+
+bool dense::load(size_t i, object_p obj)
+// ----------------------------------------------------------------------------
+//   Load a real number, converting it to decimal if necessary
+// ----------------------------------------------------------------------------
+{
+    algebraic_g value = algebraic_p(obj);
+    if (!value->is_decimal())
+    {
+        if (!algebraic::to_decimal(value))
+            return false;
+        bind();
+    }
+
+    real         *x  = at(i);
+    decimal_p     d  = decimal_p(+value);
+    decimal::info di = d->shape();
+    size_t        nk = di.nkigits;
+    zero(x);
+    if (!nk)
+        return true;
+
+    // Decimal is 0.D * 10^xe, shift it right by s digits to align on 1000^e
+    large xe   = di.exponent;
+    large e    = xe >= 0 ? (xe + 2) / 3 : -(-xe / 3);
+    uint  s    = uint(3 * e - xe);
+    uint  hdiv = s == 0 ? 1 : s == 1 ? 10 : 100;
+    uint  lmul = 1000 / hdiv;
+    kint *xm   = m(x);
+    kint  prev = 0;
+    for (size_t k = 0; k < prec; k++)
+    {
+        kint cur = k < nk ? decimal::kigit(di.base, k) : 0;
+        xm[k] = cur / hdiv + prev % hdiv * lmul;
+        prev = cur;
+    }
+    x->exp = e;
+    x->neg = d->type() == object::ID_neg_decimal;
+    return true;
+}
+
+
+bool dense::load(array_r a, bool vector)
+// ----------------------------------------------------------------------------
+//   Load all the elements of a matrix or vector
+// ----------------------------------------------------------------------------
+{
+    bind();
+    size_t i = 0;
+    for (object_p obj : *a)
+    {
+        if (vector)
+        {
+            if (!load(i++, obj))
+                return false;
+            continue;
+        }
+        array_g row = array_p(obj);
+        for (object_p elem : *row)
+            if (!load(i++, elem))
+                return false;
+    }
+    return true;
+}
+
+
+void dense::fma(real *r, real *x, real *y, bool sub)
+// ----------------------------------------------------------------------------
+//   Compute r += x * y, or r -= x * y, with an exact intermediate product
+// ----------------------------------------------------------------------------
+//   r may be the same element as x or y
+{
+    if (is_zero(x) || is_zero(y))
+        return;
+
+    // Exact product of the mantissas, 0.prod * 1000^(x->exp + y->exp)
+    kint  *xm = m(x);
+    kint  *ym = m(y);
+    size_t pn = 2 * prec;
+    for (size_t k = 0; k < pn; k++)
+        prod[k] = 0;
+    for (size_t i = 0; i < prec; i++)
+        if (uint32_t xk = xm[i])
+            for (size_t j = 0; j < prec; j++)
+                prod[i + j + 1] += xk * ym[j];
+    for (size_t k = pn - 1; k > 0; k--)
+    {
+        prod[k - 1] += prod[k] / 1000;
+        prod[k] %= 1000;
+    }
+    large pexp = x->exp + y->exp;
+    bool  pneg = (x->neg != y->neg) != sub;
+
+    // Align both operands below a common exponent with room for a carry
+    bool   rz   = is_zero(r);
+    large  top  = rz || pexp > r->exp ? pexp : r->exp;
+    large  E    = top + 1;
+    size_t wide = pn + 2;
+    kint  *rm   = m(r);
+    for (size_t k = 0; k < wide; k++)
+        wx[k] = wy[k] = 0;
+    large po = E - pexp;
+    for (size_t j = 0; j < pn && po + large(j) < large(wide); j++)
+        wy[po + j] = prod[j];
+    if (!rz)
+    {
+        large ro = E - r->exp;
+        for (size_t i = 0; i < prec && ro + large(i) < large(wide); i++)
+            wx[ro + i] = rm[i];
+    }
+
+    // Add or subtract magnitudes
+    bool   rneg = rz ? pneg : r->neg;
+    size_t lead = wide;
+    kint   lk   = 0;
+    if (rneg == pneg)
+    {
+        uint carry = 0;
+        for (size_t k = wide; k-- > 0; )
+        {
+            uint sum = wx[k] + wy[k] + carry;
+            carry = sum >= 1000;
+            wx[k] = carry ? sum - 1000 : sum;
+        }
+    }
+    else
+    {
+        size_t d = 0;
+        while (d < wide && wx[d] == wy[d])
+            d++;
+        if (d == wide)
+        {
+            zero(r);
+            return;
+        }
+        kint *big = wx, *small = wy;
+        if (wx[d] < wy[d])
+        {
+            std::swap(big, small);
+            rneg = pneg;
+        }
+        lead = 0;
+        while (big[lead] == 0)
+            lead++;
+        lk = big[lead];
+        uint borrow = 0;
+        for (size_t k = wide; k-- > 0; )
+        {
+            int diff = int(big[k]) - int(small[k]) - int(borrow);
+            borrow = diff < 0;
+            wx[k] = borrow ? diff + 1000 : diff;
+        }
+    }
+
+    // Normalize and truncate the result
+    size_t f = 0;
+    while (f < wide && wx[f] == 0)
+        f++;
+
+    // Cancellation of all the significant digits leaves only rounding noise
+    if (f == wide)
+    {
+        zero(r);
+        return;
+    }
+    if (lead < wide)
+    {
+        kint   rk   = wx[f];
+        size_t bpos = 3 * lead + (lk >= 100 ? 0 : lk >= 10 ? 1 : 2);
+        size_t rpos = 3 * f + (rk >= 100 ? 0 : rk >= 10 ? 1 : 2);
+        if (rpos >= bpos + digits)
+        {
+            zero(r);
+            return;
+        }
+    }
+    for (size_t i = 0; i < prec; i++)
+        rm[i] = f + i < wide ? wx[f + i] : 0;
+    r->exp = E - large(f);
+    r->neg = rneg;
+}
+
+
+int dense::compare(real *x, real *y)
+// ----------------------------------------------------------------------------
+//   Compare the magnitude of two elements
+// ----------------------------------------------------------------------------
+{
+    bool xz = is_zero(x);
+    bool yz = is_zero(y);
+    if (xz || yz)
+        return int(yz) - int(xz);
+    if (x->exp != y->exp)
+        return x->exp < y->exp ? -1 : 1;
+    kint *xm = m(x);
+    kint *ym = m(y);
+    for (size_t i = 0; i < prec; i++)
+        if (xm[i] != ym[i])
+            return xm[i] < ym[i] ? -1 : 1;
+    return 0;
+}
+
+
+void dense::reciprocal(real *r, real *x)
+// ----------------------------------------------------------------------------
+//   Compute 1/x with Newton iterations from a hardware approximation
+// ----------------------------------------------------------------------------
+{
+    // Mantissa of x is in [0.001, 1), so 1/x is (1/mantissa) * 1000^-exp
+    kint  *xm    = m(x);
+    double v     = 0.0;
+    double scale = 1.0;
+    for (size_t i = 0; i < prec && i < 6; i++)
+    {
+        scale /= 1000.0;
+        v += xm[i] * scale;
+    }
+    v = 1.0 / v;
+    large e = -x->exp;
+    while (v >= 1.0)
+    {
+        v /= 1000.0;
+        e++;
+    }
+
+    zero(r);
+    kint *rm = m(r);
+    for (size_t i = 0; i < prec && i < 6; i++)
+    {
+        v *= 1000.0;
+        kint k = v >= 999.0 ? 999 : kint(v);
+        rm[i] = k;
+        v -= k;
+    }
+    r->exp = e;
+    r->neg = x->neg;
+
+    // Each iteration r += r * (1 - x * r) doubles the number of digits
+    real *t = scratch(0);
+    for (size_t digits = 7; digits < 6 * prec; digits *= 2)
+    {
+        one(t);
+        fma(t, x, r, true);
+        fma(r, r, t);
+    }
+}
+
+
+void dense::divide(real *q, real *x, real *y, real *recip)
+// ----------------------------------------------------------------------------
+//   Compute q = x / y given an approximate reciprocal of y
+// ----------------------------------------------------------------------------
+//   The correction step q += (x - q * y) * recip recovers the last kigits
+{
+    real *t = scratch(0);
+    real *r = scratch(1);
+    zero(t);
+    fma(t, x, recip);
+    copy(r, x);
+    fma(r, t, y, true);
+    fma(t, r, recip);
+    copy(q, t);
+}
+
+
+bool dense::lu(bool *neg)
+// ----------------------------------------------------------------------------
+//   In-place LU decomposition with partial pivoting
+// ----------------------------------------------------------------------------
+//   On return, the strict lower part holds L (unit diagonal), the upper part
+//   holds U, perm[i] is the original row of row i, and temps hold 1/U[i,i].
+//   Returns false if the matrix is singular.
+{
+    bind();
+    size_t n = rows;
+    for (size_t i = 0; i < n; i++)
+        perm[i] = i;
+
+    for (size_t k = 0; k < n; k++)
+    {
+        // Select the largest pivot in column k
+        size_t p = k;
+        for (size_t i = k + 1; i < n; i++)
+            if (compare(at(i, k), at(p, k)) > 0)
+                p = i;
+        if (is_zero(at(p, k)))
+            return false;
+
+        if (p != k)
+        {
+            uint64_t *a = (uint64_t *) at(p, 0);
+            uint64_t *b = (uint64_t *) at(k, 0);
+            for (size_t w = 0; w < n * stride / sizeof(uint64_t); w++)
+                std::swap(a[w], b[w]);
+            std::swap(perm[p], perm[k]);
+            *neg = !*neg;
+        }
+
+        // Eliminate below the pivot
+        real *pivot = at(k, k);
+        real *recip = temp(k);
+        reciprocal(recip, pivot);
+        for (size_t i = k + 1; i < n; i++)
+        {
+            real *l = at(i, k);
+            if (is_zero(l))
+                continue;
+            divide(l, l, pivot, recip);
+            for (size_t j = k + 1; j < n; j++)
+                fma(at(i, j), l, at(k, j), true);
+        }
+    }
+    return true;
+}
+
+
+void dense::solve(dense *b, dense &x)
+// ----------------------------------------------------------------------------
+//   Solve A * X = B using the LU decomposition of A, B = identity if null
+// ----------------------------------------------------------------------------
+{
+    bind();
+    if (b)
+        b->bind();
+    x.bind();
+    size_t n = rows;
+    for (size_t c = 0; c < x.cols; c++)
+    {
+        // Forward substitution L * Y = P * B
+        for (size_t i = 0; i < n; i++)
+        {
+            real *y = x.at(i, c);
+            if (b)
+                copy(y, b->at(perm[i], c));
+            else if (perm[i] == c)
+                one(y);
+            else
+                zero(y);
+            for (size_t k = 0; k < i; k++)
+                fma(y, at(i, k), x.at(k, c), true);
+        }
+
+        // Backward substitution U * X = Y
+        for (size_t i = n; i-- > 0; )
+        {
+            real *xi = x.at(i, c);
+            for (size_t k = i + 1; k < n; k++)
+                fma(xi, at(i, k), x.at(k, c), true);
+            if (!is_zero(xi))
+                divide(xi, xi, at(i, i), temp(i));
+        }
+    }
+}
+
+
+bool dense::round(real *x, large &exp, size_t &nkigits)
+// ----------------------------------------------------------------------------
+//   Round an element to the current precision, with the kigits in prod
+// ----------------------------------------------------------------------------
+{
+    exp = 0;
+    nkigits = 0;
+    if (is_zero(x))
+        return true;
+
+    // Shift left so that the first digit is not zero, as for decimal
+    kint  *xm   = m(x);
+    kint  *d    = (kint *) prod;
+    uint   s    = xm[0] >= 100 ? 0 : xm[0] >= 10 ? 1 : 2;
+    uint   hmul = s == 0 ? 1 : s == 1 ? 10 : 100;
+    uint   ldiv = 1000 / hmul;
+    for (size_t i = 0; i < prec; i++)
+    {
+        kint next = i + 1 < prec ? xm[i + 1] : 0;
+        d[i] = (xm[i] * hmul + next / ldiv) % 1000;
+    }
+    exp = 3 * x->exp - s;
+
+    // Round to the current precision
+    size_t rs = prec - GUARD;
+    if (d[rs] >= 500)
+    {
+        bool   carry = true;
+        size_t i     = rs;
+        while (carry && i-- > 0)
+        {
+            carry = ++d[i] >= 1000;
+            if (carry)
+                d[i] = 0;
+        }
+        if (carry)
+        {
+            d[0] = 100;
+            exp++;
+        }
+    }
+    while (rs && d[rs - 1] == 0)
+        rs--;
+    if (exp > DB48X_MAXEXPONENT || exp < -DB48X_MAXEXPONENT)
+    {
+        rt.exponent_range_error();
+        return false;
+    }
+    nkigits = rs;
+    return true;
+}
+
+
+algebraic_p dense::store(size_t i)
+// ----------------------------------------------------------------------------
+//   Convert an element back to a decimal, rounding the guard kigits
+// ----------------------------------------------------------------------------
+{
+    bind();
+    real  *x   = at(i);
+    large  exp = 0;
+    size_t n   = 0;
+    if (!round(x, exp, n))
+        return nullptr;
+
+    gcp<kint> kigits = (kint *) prod;
+    return rt.make<decimal>(x->neg && n ? object::ID_neg_decimal
+                                        : object::ID_decimal,
+                            exp, n, kigits);
+}
+
+
+bool dense::append(size_t i)
+// ----------------------------------------------------------------------------
+//   Append an element as a decimal at the end of the scratchpad
+// ----------------------------------------------------------------------------
+//   This does not allocate a temporary, so the scratchpad does not move
+//   unless we run out of memory and garbage is collected
+{
+    bind();
+    real  *x   = at(i);
+    large  exp = 0;
+    size_t n   = 0;
+    if (!round(x, exp, n))
+        return false;
+
+    object::id type = x->neg && n ? object::ID_neg_decimal
+                                  : object::ID_decimal;
+    size_t     sz   = decimal::required_memory(type, exp, n, gcp<kint>());
+    byte      *p    = rt.allocate(sz);
+    if (!p)
+        return false;
+    bind();
+    gcp<kint> kigits = (kint *) prod;
+    new((decimal *) p) decimal(type, exp, n, kigits);
+    return true;
+}
+
+
+array_p dense::store(bool vector)
+// ----------------------------------------------------------------------------
+//   Convert the matrix back to an array of decimals
+// ----------------------------------------------------------------------------
+{
+    scribble sr;
+    for (size_t r = 0; r < rows; r++)
+    {
+        if (vector)
+        {
+            if (!append(r * cols))
+                return nullptr;
+            continue;
+        }
+
+        object_g row;
+        {
+            scribble sv;
+            for (size_t c = 0; c < cols; c++)
+                if (!append(r * cols + c))
+                    return nullptr;
+            row = list::make(object::ID_array, sv.scratch(), sv.growth());
+        }
+        if (!row || !rt.append(row->size(), byte_p(+row)))
+            return nullptr;
+    }
+    return array_p(list::make(object::ID_array, sr.scratch(), sr.growth()));
+}
+
+
+static bool dense_shape(array_p a, size_t *rows, size_t *cols, bool *decimals)
+// ----------------------------------------------------------------------------
+//   Check if an array is a matrix (or vector if rows is null) of reals
+// ----------------------------------------------------------------------------
+{
+    if (rows ? !a->is_matrix(rows, cols, false) : !a->is_vector(cols, false))
+        return false;
+    for (object_p obj : *a)
+    {
+        if (rows)
+        {
+            for (object_p elem : *array_p(obj))
+            {
+                if (!elem->is_real())
+                    return false;
+                *decimals |= elem->is_decimal();
+            }
+        }
+        else
+        {
+            if (!obj->is_real())
+                return false;
+            *decimals |= obj->is_decimal();
+        }
+    }
+    return true;
+}
+
+
+static bool dense_determinant(array_r a, algebraic_g &det)
+// ----------------------------------------------------------------------------
+//   Compute the determinant with a dense LU decomposition if possible
+// ----------------------------------------------------------------------------
+//   Returns true if it applied, in which case det is null on error
+{
+    size_t rows = 0, cols = 0;
+    bool   decimals = false;
+    if (!dense_shape(a, &rows, &cols, &decimals) || !decimals || rows != cols)
+        return false;
+
+    size_t n = rows;
+    dense  m(n, n, n);
+    bool   ok = m;
+    if (ok)
+    {
+        bool neg = false;
+        det = nullptr;
+        if (m.load(a))
+        {
+            if (!m.lu(&neg))
+            {
+                det = integer::make(0);
+            }
+            else
+            {
+                dense::real *d = m.temp(0);
+                dense::real *t = m.scratch(1);
+                m.one(d);
+                for (size_t i = 0; i < n; i++)
+                {
+                    m.zero(t);
+                    m.fma(t, d, m.at(i, i));
+                    m.copy(d, t);
+                }
+                d->neg = d->neg != neg;
+                det = m.store(n * n);
+            }
+        }
+    }
+    return ok;
+}
+
+
+static bool dense_invert(array_r a, array_g &inv)
+// ----------------------------------------------------------------------------
+//   Invert a matrix with a dense LU decomposition if possible
+// ----------------------------------------------------------------------------
+{
+    size_t rows = 0, cols = 0;
+    bool   decimals = false;
+    if (!dense_shape(a, &rows, &cols, &decimals) || !decimals || rows != cols)
+        return false;
+
+    size_t n = rows;
+    dense  m(n, n, n);
+    dense  x(n, n);
+    bool   ok = m && x;
+    if (ok)
+    {
+        bool neg = false;
+        inv = nullptr;
+        if (m.load(a))
+        {
+            if (!m.lu(&neg))
+            {
+                rt.zero_divide_error();
+            }
+            else
+            {
+                m.solve(nullptr, x);
+                inv = x.store();
+            }
+        }
+    }
+    return ok;
+}
+
+
+static bool dense_product(array_r x, array_r y, bool divide, array_g &result)
+// ----------------------------------------------------------------------------
+//   Compute x * y, or inv(y) * x for a division, with dense matrices
+// ----------------------------------------------------------------------------
+{
+    size_t rx = 0, cx = 0, ry = 0, cy = 0;
+    bool   decimals = false;
+    bool   vector = false;
+    if (!dense_shape(x, &rx, &cx, &decimals))
+        return false;
+    if (!dense_shape(y, &ry, &cy, &decimals))
+    {
+        if (divide || !dense_shape(y, nullptr, &ry, &decimals))
+            return false;
+        cy = 1;
+        vector = true;
+    }
+    if (!decimals)
+        return false;
+    if (divide ? ry != cy || rx != ry : cx != ry)
+        return false;
+
+    dense xd(rx, cx);
+    dense yd(ry, cy, divide ? ry : 0);
+    dense rd(rx, divide ? cx : cy);
+    bool  ok = xd && yd && rd;
+    if (ok)
+    {
+        result = nullptr;
+        if (xd.load(x) && yd.load(y, vector))
+        {
+            if (divide)
+            {
+                bool neg = false;
+                if (!yd.lu(&neg))
+                {
+                    rt.zero_divide_error();
+                }
+                else
+                {
+                    yd.solve(&xd, rd);
+                    result = rd.store();
+                }
+            }
+            else
+            {
+                xd.bind();
+                yd.bind();
+                rd.bind();
+                for (size_t r = 0; r < rx; r++)
+                {
+                    for (size_t c = 0; c < cy; c++)
+                    {
+                        dense::real *e = rd.at(r, c);
+                        rd.zero(e);
+                        for (size_t k = 0; k < cx; k++)
+                            rd.fma(e, xd.at(r, k), yd.at(k, c));
+                    }
+                }
+                result = rd.store(vector);
+            }
+        }
+    }
+    return ok;
+}
+
+
+
 // ============================================================================
 //
 //    Determinant
@@ -392,6 +1221,10 @@ algebraic_g array::determinant() const
 //   Compute the determinant of a square matrix
 // ----------------------------------------------------------------------------
 {
+    algebraic_g dense_det;
+    if (dense_determinant(this, dense_det))
+        return dense_det;
+
     size_t cx, rx;
     size_t depth = rt.depth();
     if (is_matrix(&rx, &cx))
@@ -694,6 +1527,10 @@ array_g array::invert() const
 //   - pt points to the end of the temporary area initialized with identity
 //   Matrix elements are accessed as rt.stack(p + ~o) where o = r * cols + c
 {
+    array_g dense_inv;
+    if (dense_invert(this, dense_inv))
+        return dense_inv;
+
     size_t cx, rx;
     size_t depth = rt.depth();
     id     atype = type();
@@ -1080,6 +1917,14 @@ array_g array::do_matrix(array_r x, array_r y,
         return array_p(list::make(ty, scr.scratch(), scr.growth()));
     }
 
+    // Products and divisions of decimal matrices do not need the stack
+    if (mat == matrix_mul || mat == matrix_div)
+    {
+        array_g result;
+        if (dense_product(x, y, mat == matrix_div, result))
+            return result;
+    }
+
     if (x->is_matrix(&rx, &cx))
     {
         bool vector = false;
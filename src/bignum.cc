@@ -98,7 +98,7 @@ integer_p bignum::as_integer() const
     for (uint i = 0; i < size; i++)
         value |= ularge(p[i]) << (i * 8);
     id ty = type() == ID_neg_bignum ? ID_neg_integer : ID_integer;
-    return rt.make<integer>(ty, value);
+    return integer::make(ty, value);
 }
 
 
@@ -496,6 +496,400 @@ bignum_g operator^(bignum_r y, bignum_r x)
 }
 
 
+// ============================================================================
+//
+//    Limb engine for multiplication and division
+//
+// ============================================================================
+//   Multiplication and division work on 32-bit limbs with 64-bit accumulators.
+//   The storage format remains little-endian bytes, so limbs are loaded from
+//   and stored to bytes explicitly. Large products use Karatsuba, and
+//   division uses Knuth's algorithm D (TAOCP vol. 2, 4.3.1).
+
+typedef uint32_t limb;
+typedef uint64_t dlimb;
+
+enum
+{
+    LIMB_BYTES          = sizeof(limb),
+    LIMB_BITS           = 8 * sizeof(limb),
+    KARATSUBA_THRESHOLD = 24,   // Limbs below which schoolbook is faster
+};
+
+
+static inline size_t limbs_for(size_t bytes)
+// ----------------------------------------------------------------------------
+//   Number of limbs required to store the given number of bytes
+// ----------------------------------------------------------------------------
+{
+    return (bytes + LIMB_BYTES - 1) / LIMB_BYTES;
+}
+
+
+static limb *limbs_allocate(size_t count, size_t &allocated)
+// ----------------------------------------------------------------------------
+//   Allocate limb-aligned storage in the scratchpad
+// ----------------------------------------------------------------------------
+//   This may GC, so the caller must re-read any object pointer afterwards
+{
+    allocated = count * LIMB_BYTES + LIMB_BYTES - 1;
+    byte *buffer = rt.allocate(allocated);
+    if (!buffer)
+        return nullptr;
+    uintptr_t aligned = (uintptr_t(buffer) + LIMB_BYTES-1) & ~(LIMB_BYTES-1);
+    return (limb *) aligned;
+}
+
+
+static void limbs_load(limb *dst, size_t count, byte_p src, size_t bytes)
+// ----------------------------------------------------------------------------
+//   Load little-endian bytes into limbs, zero-padding to count limbs
+// ----------------------------------------------------------------------------
+{
+    for (size_t l = 0; l < count; l++)
+    {
+        limb value = 0;
+        for (size_t b = 0; b < LIMB_BYTES; b++)
+        {
+            size_t i = l * LIMB_BYTES + b;
+            if (i < bytes)
+                value |= limb(src[i]) << (8 * b);
+        }
+        dst[l] = value;
+    }
+}
+
+
+static byte *limbs_store(limb *src, size_t count)
+// ----------------------------------------------------------------------------
+//   Convert limbs to little-endian bytes in place
+// ----------------------------------------------------------------------------
+{
+    byte *dst = (byte *) src;
+    for (size_t l = 0; l < count; l++)
+    {
+        limb value = src[l];
+        for (size_t b = 0; b < LIMB_BYTES; b++)
+            dst[l * LIMB_BYTES + b] = byte(value >> (8 * b));
+    }
+    return dst;
+}
+
+
+static inline void limbs_zero(limb *r, size_t n)
+// ----------------------------------------------------------------------------
+//   Clear n limbs
+// ----------------------------------------------------------------------------
+{
+    for (size_t i = 0; i < n; i++)
+        r[i] = 0;
+}
+
+
+static inline size_t limbs_used(const limb *a, size_t n)
+// ----------------------------------------------------------------------------
+//   Return the number of significant limbs
+// ----------------------------------------------------------------------------
+{
+    while (n > 0 && a[n-1] == 0)
+        n--;
+    return n;
+}
+
+
+static limb limbs_add(limb *r, const limb *a, size_t n)
+// ----------------------------------------------------------------------------
+//   Add n limbs of a to r, return the carry
+// ----------------------------------------------------------------------------
+{
+    dlimb c = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        c += dlimb(r[i]) + a[i];
+        r[i] = limb(c);
+        c >>= LIMB_BITS;
+    }
+    return limb(c);
+}
+
+
+static limb limbs_sub(limb *r, const limb *a, size_t n)
+// ----------------------------------------------------------------------------
+//   Subtract n limbs of a from r, return the borrow
+// ----------------------------------------------------------------------------
+{
+    limb borrow = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        dlimb d = dlimb(r[i]) - a[i] - borrow;
+        r[i] = limb(d);
+        borrow = limb(d >> LIMB_BITS) & 1;
+    }
+    return borrow;
+}
+
+
+static void limbs_carry(limb *r, size_t n, limb c)
+// ----------------------------------------------------------------------------
+//   Propagate a carry in the n limbs of r
+// ----------------------------------------------------------------------------
+{
+    for (size_t i = 0; c && i < n; i++)
+    {
+        r[i] += c;
+        c = r[i] < c;
+    }
+}
+
+
+static void limbs_borrow(limb *r, size_t n, limb b)
+// ----------------------------------------------------------------------------
+//   Propagate a borrow in the n limbs of r
+// ----------------------------------------------------------------------------
+{
+    for (size_t i = 0; b && i < n; i++)
+    {
+        limb old = r[i];
+        r[i] = old - b;
+        b = old < b;
+    }
+}
+
+
+static limb limbs_addmul1(limb *r, const limb *a, size_t n, limb b)
+// ----------------------------------------------------------------------------
+//   Add a * b to r, return the carry limb
+// ----------------------------------------------------------------------------
+{
+    dlimb c = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        c += dlimb(a[i]) * b + r[i];
+        r[i] = limb(c);
+        c >>= LIMB_BITS;
+    }
+    return limb(c);
+}
+
+
+static void limbs_schoolbook(limb *r,
+                             const limb *a, size_t an,
+                             const limb *b, size_t bn)
+// ----------------------------------------------------------------------------
+//   Quadratic multiplication, r must have an + bn limbs
+// ----------------------------------------------------------------------------
+{
+    limbs_zero(r, an + bn);
+    for (size_t j = 0; j < bn; j++)
+        if (limb bj = b[j])
+            r[j + an] = limbs_addmul1(r + j, a, an, bj);
+}
+
+
+static size_t limbs_karatsuba_scratch(size_t n)
+// ----------------------------------------------------------------------------
+//   Number of limbs of scratch space required by limbs_karatsuba
+// ----------------------------------------------------------------------------
+{
+    if (n < KARATSUBA_THRESHOLD)
+        return 0;
+    size_t m = n - n / 2;
+    return 4 * (m + 1) + limbs_karatsuba_scratch(m + 1);
+}
+
+
+static void limbs_karatsuba(limb *r, const limb *a, const limb *b, size_t n,
+                            limb *tmp)
+// ----------------------------------------------------------------------------
+//   Karatsuba multiplication of two n-limb values into 2n limbs of r
+// ----------------------------------------------------------------------------
+//   With a = a1 B^h + a0 and b = b1 B^h + b0, we have
+//   a b = z2 B^2h + (z1 - z2 - z0) B^h + z0, where
+//   z0 = a0 b0, z2 = a1 b1, and z1 = (a0 + a1)(b0 + b1)
+{
+    if (n < KARATSUBA_THRESHOLD)
+    {
+        limbs_schoolbook(r, a, n, b, n);
+        return;
+    }
+
+    size_t h = n / 2;
+    size_t m = n - h;
+    limb *sa = tmp;
+    limb *sb = sa + m + 1;
+    limb *z1 = sb + m + 1;
+    limb *next = z1 + 2 * (m + 1);
+
+    // Compute z0 and z2 directly in the result
+    limbs_karatsuba(r, a, b, h, next);
+    limbs_karatsuba(r + 2*h, a + h, b + h, m, next);
+
+    // Compute (a0 + a1) and (b0 + b1) on m + 1 limbs
+    for (size_t i = 0; i < m; i++)
+    {
+        sa[i] = a[h + i];
+        sb[i] = b[h + i];
+    }
+    sa[m] = sb[m] = 0;
+    limbs_carry(sa + h, m + 1 - h, limbs_add(sa, a, h));
+    limbs_carry(sb + h, m + 1 - h, limbs_add(sb, b, h));
+    limbs_karatsuba(z1, sa, sb, m + 1, next);
+
+    // Subtract z0 and z2 from z1, then add it in the middle of the result
+    size_t zn = 2 * (m + 1);
+    limbs_borrow(z1 + 2*h, zn - 2*h, limbs_sub(z1, r, 2*h));
+    limbs_borrow(z1 + 2*m, zn - 2*m, limbs_sub(z1, r + 2*h, 2*m));
+    zn = limbs_used(z1, zn);
+    limbs_carry(r + h + zn, 2*n - h - zn, limbs_add(r + h, z1, zn));
+}
+
+
+static size_t limbs_mul_scratch(size_t an, size_t bn)
+// ----------------------------------------------------------------------------
+//   Number of limbs of scratch space required by limbs_mul
+// ----------------------------------------------------------------------------
+{
+    size_t n = an < bn ? an : bn;
+    if (n < KARATSUBA_THRESHOLD)
+        return 0;
+    return 2 * n + limbs_karatsuba_scratch(n);
+}
+
+
+static void limbs_mul(limb *r,
+                      const limb *a, size_t an,
+                      const limb *b, size_t bn,
+                      limb *tmp)
+// ----------------------------------------------------------------------------
+//   Multiply a and b into the an + bn limbs of r
+// ----------------------------------------------------------------------------
+//   When the shorter operand is large enough, the longer one is cut into
+//   chunks of the same size that are multiplied using Karatsuba
+{
+    if (an < bn)
+    {
+        std::swap(a, b);
+        std::swap(an, bn);
+    }
+    if (bn < KARATSUBA_THRESHOLD)
+    {
+        limbs_schoolbook(r, a, an, b, bn);
+        return;
+    }
+
+    limbs_zero(r, an + bn);
+    size_t done = 0;
+    for (; an - done >= bn; done += bn)
+    {
+        limbs_karatsuba(tmp, a + done, b, bn, tmp + 2 * bn);
+        limb c = limbs_add(r + done, tmp, 2 * bn);
+        limbs_carry(r + done + 2 * bn, an - done - bn, c);
+    }
+    if (size_t rest = an - done)
+        for (size_t j = 0; j < bn; j++)
+            limbs_carry(r + done + rest + j, bn - j,
+                        limbs_addmul1(r + done + j, a + done, rest, b[j]));
+}
+
+
+static inline uint limbs_clz(limb x)
+// ----------------------------------------------------------------------------
+//   Count leading zero bits in a non-zero limb
+// ----------------------------------------------------------------------------
+{
+    uint n = 0;
+    while (!(x & (limb(1) << (LIMB_BITS - 1))))
+    {
+        x <<= 1;
+        n++;
+    }
+    return n;
+}
+
+
+static void limbs_divmod(limb *q, limb *r,
+                         const limb *u, size_t un,
+                         const limb *v, size_t vn,
+                         limb *tmp)
+// ----------------------------------------------------------------------------
+//   Divide u by v, quotient in q (un-vn+1 limbs), remainder in r (vn limbs)
+// ----------------------------------------------------------------------------
+//   Requires un >= vn, v[vn-1] != 0, and un + 1 + vn limbs of scratch in tmp.
+//   This is Knuth's algorithm D, with digits being limbs.
+{
+    const dlimb B = dlimb(1) << LIMB_BITS;
+
+    // Short division by a single limb
+    if (vn == 1)
+    {
+        dlimb rem = 0;
+        for (size_t i = un; i-- > 0; )
+        {
+            rem = (rem << LIMB_BITS) | u[i];
+            q[i] = limb(rem / v[0]);
+            rem %= v[0];
+        }
+        r[0] = limb(rem);
+        return;
+    }
+
+    // D1: Normalize so that the top bit of the divisor is set
+    uint  s  = limbs_clz(v[vn-1]);
+    limb *un_ = tmp;
+    limb *vn_ = tmp + un + 1;
+    for (size_t i = vn - 1; i > 0; i--)
+        vn_[i] = (v[i] << s) | (s ? limb(dlimb(v[i-1]) >> (LIMB_BITS-s)) : 0);
+    vn_[0] = v[0] << s;
+    un_[un] = s ? limb(dlimb(u[un-1]) >> (LIMB_BITS - s)) : 0;
+    for (size_t i = un - 1; i > 0; i--)
+        un_[i] = (u[i] << s) | (s ? limb(dlimb(u[i-1]) >> (LIMB_BITS-s)) : 0);
+    un_[0] = u[0] << s;
+
+    // D2-D7: Loop on the digits of the quotient
+    for (size_t j = un - vn + 1; j-- > 0; )
+    {
+        // D3: Estimate the quotient digit
+        dlimb num  = (dlimb(un_[j+vn]) << LIMB_BITS) | un_[j+vn-1];
+        dlimb qhat = num / vn_[vn-1];
+        dlimb rhat = num % vn_[vn-1];
+        while (qhat >= B ||
+               qhat * vn_[vn-2] > ((rhat << LIMB_BITS) | un_[j+vn-2]))
+        {
+            qhat--;
+            rhat += vn_[vn-1];
+            if (rhat >= B)
+                break;
+        }
+
+        // D4: Multiply and subtract
+        limb  borrow = 0;
+        dlimb carry  = 0;
+        for (size_t i = 0; i < vn; i++)
+        {
+            carry += qhat * vn_[i];
+            dlimb d = dlimb(un_[i+j]) - limb(carry) - borrow;
+            un_[i+j] = limb(d);
+            borrow = limb(d >> LIMB_BITS) & 1;
+            carry >>= LIMB_BITS;
+        }
+        dlimb d = dlimb(un_[j+vn]) - limb(carry) - borrow;
+        un_[j+vn] = limb(d);
+
+        // D5-D6: If we subtracted too much, add back
+        if ((d >> LIMB_BITS) & 1)
+        {
+            qhat--;
+            un_[j+vn] += limbs_add(un_ + j, vn_, vn);
+        }
+        q[j] = limb(qhat);
+    }
+
+    // D8: Unnormalize the remainder
+    for (size_t i = 0; i < vn; i++)
+        r[i] = (un_[i] >> s) | (s ? limb(dlimb(un_[i+1]) << (LIMB_BITS-s)) : 0);
+}
+
+
 bignum_g bignum::multiply(bignum_r yg, bignum_r xg, id ty)
 // ----------------------------------------------------------------------------
 //   Perform multiply operation on the two big nums, with result type ty
@@ -514,52 +908,37 @@ bignum_g bignum::multiply(bignum_r yg, bignum_r xg, id ty)
         rt.number_too_big_error();
         return nullptr;
     }
-    if (wbits && needed > wbytes)
-        needed = wbytes;
-    byte *buffer = rt.allocate(needed);       // May GC here
-    if (!buffer)
+
+    // Allocate result, operands and scratch as limbs
+    size_t xl = limbs_for(xs);
+    size_t yl = limbs_for(ys);
+    size_t rl = xl + yl;
+    size_t tl = limbs_mul_scratch(xl, yl);
+    size_t allocated = 0;
+    limb *rp = limbs_allocate(rl + xl + yl + tl, allocated); // May GC here
+    if (!rp)
         return nullptr;                       // Out of memory
+    limb *xp = rp + rl;
+    limb *yp = xp + xl;
     x = xg->value(&xs);                       // Re-read after potential GC
     y = yg->value(&ys);
+    limbs_load(xp, xl, x, xs);
+    limbs_load(yp, yl, y, ys);
+    if (xl && yl)
+        limbs_mul(rp, xp, xl, yp, yl, yp + yl);
+    else
+        limbs_zero(rp, rl);
 
-    // Zero-initialie the result
-    for (size_t i = 0; i < needed; i++)
-        buffer[i] = 0;
-
-    // Loop on all bytes of x then y
-    for (size_t xi = 0; xi < xs; xi++)
-    {
-        byte xd = x[xi];
-        for (int bit = 0; xd && bit < 8; bit++)
-        {
-            if (xd & (1<<bit))
-            {
-                uint c = 0;
-                size_t yi;
-                for (yi = 0; yi < ys && xi + yi < needed; yi++)
-                {
-                    c += buffer[xi + yi] + (y[yi] << bit);
-                    buffer[xi + yi] = byte(c);
-                    c >>= 8;
-                }
-                while (c && xi + yi < needed)
-                {
-                    c += buffer[xi + yi];
-                    buffer[xi + yi] = byte(c);
-                    c >>= 8;
-                    yi++;
-                }
-                xd &= ~(1<<bit);
-            }
-        }
-    }
-
+    // Convert back to bytes, truncating to word size for based numbers
+    byte *buffer = limbs_store(rp, rl);
     size_t sz = needed;
+    if (wbits && sz > wbytes)
+        sz = wbytes;
     while (sz > 0 && buffer[sz-1] == 0)
         sz--;
     gcbytes buf = buffer;
     bignum_g result = rt.make<bignum>(ty, buf, sz);
-    rt.free(needed);
+    rt.free(allocated);
     return result;
 }
 
@@ -582,7 +961,7 @@ bool bignum::quorem(bignum_r yg, bignum_r xg, id ty, bignum_g *q, bignum_g *r)
 // ----------------------------------------------------------------------------
 //   Compute quotient and remainder of two bignums, as bignums
 // ----------------------------------------------------------------------------
-//   Result is placed in scratchpad, the function returns the size in bytes
+//   The computation is done on limbs in the scratchpad, see limbs_divmod
 {
     if (xg->is_zero())
     {
@@ -590,84 +969,57 @@ bool bignum::quorem(bignum_r yg, bignum_r xg, id ty, bignum_g *q, bignum_g *r)
         return false;
     }
 
-    // In the computations below (e.g. needed), the size of the quotient is
-    // less than the size of y, and the size of the remainder is less than the
-    // size of x, therefore, we need at most xs + ys for both.
-    // However, the computation of the remainder requires a subtraction
-    // which can be one byte larger than x (see issue #70 for details).
-    // For example in 0x17B/0xEF, the first remainder subtraction will be
-    // 0x17B - 0xEF, which does require two bytes, not just one. It could
-    // be carried out by keeping the extra byte in a variable, but it's
-    // simpler to allocate one extra byte.
+    // The quotient needs at most yl limbs and the remainder at most xl limbs.
+    // Algorithm D needs yl + 1 + xl more limbs for normalized copies.
     size_t xs = 0;
     size_t ys = 0;
-    byte_p x = xg->value(&xs);                // Read those after potential GC
+    byte_p x = xg->value(&xs);
     byte_p y = yg->value(&ys);
     id xt = xg->type();
     size_t wbits = wordsize(xt);
     size_t wbytes = (wbits + 7) / 8;
-    size_t needed = ys + xs + 1;              // No need to check maxbignum
-    byte *buffer = rt.allocate(needed);       // May GC here
-    if (!buffer)
+    size_t xl = limbs_for(xs);
+    size_t yl = limbs_for(ys);
+    size_t ql = yl > xl ? yl : xl;
+    size_t allocated = 0;
+    limb *qp = limbs_allocate(ql + xl + yl + xl + (yl+1) + xl, allocated);
+    if (!qp)
         return false;                         // Out of memory
+    limb *rp = qp + ql;
+    limb *yp = rp + xl;
+    limb *xp = yp + yl;
+    limb *tp = xp + xl;
     x = xg->value(&xs);                       // Re-read after potential GC
     y = yg->value(&ys);
-
-    // Pointers ot quotient and remainder, initializer to 0
-    byte *quotient = buffer;
-    byte *remainder = quotient + ys;
-    size_t rs = 0;
-    size_t qs = 0;
-    for (uint i = 0; i < needed; i++)
-        buffer[i] = 0;
-
-    // Loop on the numerator
-    for (int yi = ys-1; yi >= 0; yi--)
+    limbs_load(yp, yl, y, ys);
+    limbs_load(xp, xl, x, xs);
+    xl = limbs_used(xp, xl);
+    yl = limbs_used(yp, yl);
+
+    // Compute quotient and remainder, with a shortcut if y < x
+    limbs_zero(qp, ql);
+    size_t qn = 0;
+    size_t rn = xl;
+    if (yl < xl)
     {
-        for (int bit = 7; bit >= 0; bit--)
-        {
-            // Shift remainder left by one bit, add numerator bit
-            uint16_t c = (y[yi] >> bit) & 1;
-            int delta = 0;
-            for (uint ri = 0; ri < rs; ri++)
-            {
-                c += (remainder[ri] << 1);
-                remainder[ri] = byte(c);
-                if (int d = remainder[ri] - x[ri])
-                    delta = d;
-                c >>= 8;
-            }
-
-            if (c)
-            {
-                if (int d = c - x[rs])
-                    delta = d;
-                remainder[rs++] = c;
-            }
-            if (rs != xs)
-                delta = int(rs) - int(xs);
-
-            // If remainder >= denominator, add to quotient, subtract from rem
-            if (delta >= 0)
-            {
-                quotient[yi] |= (1 << bit);
-                if (qs < size_t(yi + 1))
-                    qs = yi + 1;
-
-                c = 0;
-                for (uint ri = 0; ri < rs; ri++)
-                {
-                    c = remainder[ri] - (ri < xs ? x[ri] : 0) - c;
-                    remainder[ri] = byte(c);
-                    c = c > 0xFF;
-                }
+        for (size_t i = 0; i < xl; i++)
+            rp[i] = i < yl ? yp[i] : 0;
+    }
+    else
+    {
+        limbs_divmod(qp, rp, yp, yl, xp, xl, tp);
+        qn = yl - xl + 1;
+    }
 
-                // Strip zeroes at top of remainder
-                while (rs > 0 && remainder[rs-1] == 0)
-                    rs--;
-            }
-        } // numerator bit loop
-    } // numerator byte loop
+    // Convert back to bytes and strip high zeros
+    byte *quotient = limbs_store(qp, qn);
+    byte *remainder = limbs_store(rp, rn);
+    size_t qs = qn * LIMB_BYTES;
+    size_t rs = rn * LIMB_BYTES;
+    while (qs > 0 && quotient[qs-1] == 0)
+        qs--;
+    while (rs > 0 && remainder[rs-1] == 0)
+        rs--;
 
     // Generate results
     gcutf8 qg = quotient;
@@ -687,7 +1039,7 @@ bool bignum::quorem(bignum_r yg, bignum_r xg, id ty, bignum_g *q, bignum_g *r)
         *r = rt.make<bignum>(ty, rg, rs);
         ok = bignum_p(*r) != nullptr;
     }
-    rt.free(needed);
+    rt.free(allocated);
     return ok;
 }
 
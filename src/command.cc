@@ -56,6 +56,92 @@ RECORDER(command,       16, "RPL Commands");
 RECORDER(command_error, 16, "Errors processing a command");
 
 
+// ============================================================================
+//
+//   Index of command spellings
+//
+// ============================================================================
+//   Spellings are bucketed at compile time by the case-folded value of their
+//   first byte. Within a bucket, spellings remain in the order of the
+//   spellings table, so that the first match is the same as a linear scan.
+
+static constexpr object::spelling command_spellings[] =
+// ----------------------------------------------------------------------------
+//   Compile-time copy of object::spellings, only used to build the index
+// ----------------------------------------------------------------------------
+{
+#define ALIAS(ty, name)         { object::ID_##ty, name },
+#define ID(ty)                  ALIAS(ty, #ty)
+#define NAMED(ty, name)         ALIAS(ty, name) ALIAS(ty, #ty)
+#include "ids.tbl"
+};
+
+
+struct spelling_index
+// ----------------------------------------------------------------------------
+//   Spelling indexes sorted by first byte
+// ----------------------------------------------------------------------------
+{
+    enum
+    {
+        BUCKETS   = 256,
+        SPELLINGS = sizeof(command_spellings) / sizeof(*command_spellings),
+        FIRST     = 0x8000,     // Flag for first spelling of a given type
+    };
+    uint16_t    start[BUCKETS + 1];
+    uint16_t    entry[SPELLINGS];
+};
+static_assert(spelling_index::SPELLINGS < spelling_index::FIRST,
+              "Too many spellings for the spelling index");
+static_assert(size_t(spelling_index::SPELLINGS) == object::SPELLINGS,
+              "Command spellings must expand ids.tbl like object::spellings");
+
+
+static constexpr byte spelling_bucket(byte c)
+// ----------------------------------------------------------------------------
+//   Case-folded first byte, consistent with strncasecmp
+// ----------------------------------------------------------------------------
+{
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+
+static constexpr spelling_index spelling_index_build()
+// ----------------------------------------------------------------------------
+//   Counting sort of the spellings by first byte
+// ----------------------------------------------------------------------------
+{
+    spelling_index index = {};
+    uint           count[spelling_index::BUCKETS] = {};
+    for (uint i = 0; i < spelling_index::SPELLINGS; i++)
+        if (cstring name = command_spellings[i].name)
+            count[spelling_bucket(name[0])]++;
+
+    uint total = 0;
+    for (uint b = 0; b < spelling_index::BUCKETS; b++)
+    {
+        index.start[b] = total;
+        total += count[b];
+        count[b] = index.start[b];
+    }
+    index.start[spelling_index::BUCKETS] = total;
+
+    for (uint i = 0; i < spelling_index::SPELLINGS; i++)
+    {
+        if (cstring name = command_spellings[i].name)
+        {
+            bool first = i == 0 ||
+                command_spellings[i-1].type != command_spellings[i].type;
+            index.entry[count[spelling_bucket(name[0])]++] =
+                i | (first ? spelling_index::FIRST : 0);
+        }
+    }
+    return index;
+}
+
+static constexpr spelling_index spellings_by_initial = spelling_index_build();
+
+
 PARSE_BODY(command)
 // ----------------------------------------------------------------------------
 //    Try to parse this as a command, using either short or long name
@@ -73,37 +159,39 @@ PARSE_BODY(command)
     size_t  maxlen = p.length;
     size_t  len    = maxlen;
 
-    for (size_t i = 0; i < spelling_count; i++)
+    // Only scan the spellings that begin with the same (case-folded) byte
+    byte     initial = maxlen ? spelling_bucket(byte(*ref)) : 0;
+    uint16_t first   = spellings_by_initial.start[initial];
+    uint16_t last    = spellings_by_initial.start[initial + 1];
+    for (uint16_t e = first; maxlen && e < last; e++)
     {
-        if (!is_command(spellings[i].type))
+        uint16_t entry = spellings_by_initial.entry[e];
+        uint16_t s     = entry & ~spelling_index::FIRST;
+        type = spellings[s].type;
+        if (!is_command(type))
             continue;
-        if (cstring cmd = spellings[i].name)
-        {
-            if (type != spellings[i].type)
-            {
-                type = spellings[i].type;
 
-                // When parsing an equation, parse x³ as cubed(x)
-                if (eq && (type == ID_sq || type == ID_cubed || type == ID_inv))
-                    continue;
-            }
+        // When parsing an equation, parse x³ as cubed(x)
+        if (eq && (entry & spelling_index::FIRST) &&
+            (type == ID_sq || type == ID_cubed || type == ID_inv))
+            continue;
 
-            // No function names like `min` while parsing units
-            if (unit::mode && is_valid_as_name_initial(utf8(cmd)))
-                continue;
-
-            len = strlen(cmd);
-            if (len <= maxlen
-                && strncasecmp(ref, cmd, len) == 0
-                && (len >= maxlen
-                    || (eq && (!is_valid_as_name_initial(utf8(cmd)) ||
-                               ((ref[len] < '0' || ref[len] > '9') &&
-                                !is_valid_as_name_initial(utf8(ref + len)))))
-                    || is_separator(utf8(ref + len))))
-            {
-                found = type;
-                break;
-            }
+        // No function names like `min` while parsing units
+        cstring cmd = spellings[s].name;
+        if (unit::mode && is_valid_as_name_initial(utf8(cmd)))
+            continue;
+
+        len = strlen(cmd);
+        if (len <= maxlen
+            && strncasecmp(ref, cmd, len) == 0
+            && (len >= maxlen
+                || (eq && (!is_valid_as_name_initial(utf8(cmd)) ||
+                           ((ref[len] < '0' || ref[len] > '9') &&
+                            !is_valid_as_name_initial(utf8(ref + len)))))
+                || is_separator(utf8(ref + len))))
+        {
+            found = type;
+            break;
         }
     }
 
@@ -31,6 +31,7 @@
 #include "arithmetic.h"
 #include "bignum.h"
 #include "fraction.h"
+#include "list.h"
 #include "parser.h"
 #include "renderer.h"
 #include "runtime.h"
@@ -704,6 +705,56 @@ int32_t decimal::as_int32() const
 }
 
 
+struct decimal_constants
+// ----------------------------------------------------------------------------
+//   Read-only pre-encoded decimal values for 0, 0.5, 1 and 2
+// ----------------------------------------------------------------------------
+{
+    enum { ZERO = 1, HALF, ONE, TWO, COUNT = TWO };
+    enum { STRIDE = 6 };
+
+    constexpr decimal_constants(): bytes()
+    {
+        // Exponent, number of kigits and packed kigit for each constant
+        const byte payload[COUNT][4] =
+        {
+            { 0, 0, 0,    0 },          // 0
+            { 0, 1, 0x7D, 0 },          // 0.5 = 0.500 * 10^0
+            { 1, 1, 0x19, 0 },          // 1   = 0.100 * 10^1
+            { 1, 1, 0x32, 0 },          // 2   = 0.200 * 10^1
+        };
+        for (uint i = 0; i < COUNT; i++)
+        {
+            byte *p = leb128_constexpr(bytes + i * STRIDE, object::ID_decimal);
+            for (uint j = 0; j < 4; j++)
+                p[j] = payload[i][j];
+        }
+    }
+
+    byte bytes[COUNT * STRIDE];
+};
+
+static constexpr decimal_constants decimal_constant_table;
+static_assert(object::NUM_IDS < 16384, "Decimal constants table stride");
+
+
+decimal_p decimal::preallocated(uint x, large exp)
+// ----------------------------------------------------------------------------
+//   Return a preallocated decimal for common constants
+// ----------------------------------------------------------------------------
+{
+    uint index = x == 0 && exp == 0  ? decimal_constants::ZERO
+               : x == 5 && exp == -1 ? decimal_constants::HALF
+               : x == 1 && exp == 0  ? decimal_constants::ONE
+               : x == 2 && exp == 0  ? decimal_constants::TWO
+               : 0;
+    if (!index)
+        return nullptr;
+    index = (index - 1) * decimal_constants::STRIDE;
+    return decimal_p(decimal_constant_table.bytes + index);
+}
+
+
 decimal_p decimal::from_integer(integer_p value)
 // ----------------------------------------------------------------------------
 //   Create a decimal value from an integer
@@ -1149,7 +1200,7 @@ algebraic_p decimal::to_integer() const
             res = res / 100;
 
         id ty = neg ? ID_neg_integer : ID_integer;
-        return rt.make<integer>(ty, res);
+        return integer::make(ty, res);
     }
 
     bignum_g scale = bignum::make(1);
@@ -2080,40 +2131,34 @@ decimal_p decimal::sin_fracpi(uint qturns, decimal_r fp)
         // sin(x+pi/2) = cos x
         return cos_fracpi((qturns - 1U) % 4, fp);
 
-    // Scale by pi / 2, sum is between 0 and pi/4
-    decimal_g sum = fp;
-    decimal_g fact = make(2);
-    decimal_g tmp;
-    sum = sum / fact;
-    sum = sum * pi();
-    fact = make(6); // 3!
-
-    // Prepare power factor and square that we multiply by every time
-    decimal_g power = sum;
-    decimal_g square = sum * sum;
-
-    uint prec = Settings.Precision();
-    for (uint i = 3; i < prec; i += 2)
+    // Reduce to jπ/64 + r, with 0 <= r < π/64, using cached sin/cos table
+    bool      neg = fp->is_negative();
+    decimal_g a   = neg ? -fp : fp;
+    decimal_g sum, tmp;
+    large     j   = 0;
+    a = a * decimal_g(make(32));
+    if (!a || !a->split(j, sum))
+        return nullptr;
+    sum = sum * pi() * decimal_g(make(15625, -6));
+    if (j)
     {
-        power = power * square; // First iteration is x^3
-        tmp = power / fact;     // x^3 / 3!
-
-        // Check if we ran out of memory
-        if (!sum || !tmp)
-            return nullptr;
-
-        // If what we add no longer has an impact, we can exit
-        if (tmp->exponent() + large(prec) < sum->exponent())
-            break;
-
-        if ((i / 2) & 1)
-            sum = sum - tmp;
-        else
-            sum = sum + tmp;
-
-        tmp = make((i+1) * (i+2)); // First iteration: 4 * 5
-        fact = fact * tmp;
+        // sin(a+b) = sin a cos b + cos a sin b
+        ccache &cst = constants();
+        tmp = cos_series(sum);
+        sum = sin_series(sum);
+        tmp = decimal_g(cst.sin_table(j)) * tmp;
+        sum = decimal_g(cst.cos_table(j)) * sum + tmp;
     }
+    else
+    {
+        sum = sin_series(sum);
+    }
+    if (!sum)
+        return nullptr;
+
+    // sin(-x) = -sin(x)
+    if (neg)
+        sum = -sum;
 
     // sin(x+pi) = -si(x)
     if (qturns != 0)
@@ -2143,42 +2188,29 @@ decimal_p decimal::cos_fracpi(uint qturns, decimal_r fp)
         // cos(x+3*pi/2) = sin x
         return sin_fracpi((qturns - 3U) % 4, fp);
 
-    // Scale by pi / 2, sum is between 0 and pi/4
-    decimal_g sum = fp;
-    decimal_g fact = make(2); // Also 2!
-    decimal_g tmp;
-    sum = sum / fact;
-    sum = sum * pi();
-
-    // Prepare power factor and square that we multiply by every time
-    decimal_g square = sum * sum;
-    decimal_g power = square;
-
-    // For cosine, the sum starts at 1
-    sum = make(1);
-
-    uint prec = Settings.Precision();
-    for (uint i = 2; i < prec; i += 2)
+    // Reduce to jπ/64 + r, with 0 <= r < π/64, using cached sin/cos table
+    decimal_g a   = fp->is_negative() ? -fp : fp;
+    decimal_g sum, tmp;
+    large     j   = 0;
+    a = a * decimal_g(make(32));
+    if (!a || !a->split(j, sum))
+        return nullptr;
+    sum = sum * pi() * decimal_g(make(15625, -6));
+    if (j)
     {
-        tmp = power / fact;     // x^2 / 2!
-
-        // Check if we ran out of memory
-        if (!sum || !tmp)
-            return nullptr;
-
-        // If what we add no longer has an impact, we can exit
-        if (tmp->exponent() + large(prec) < sum->exponent())
-            break;
-
-        if ((i / 2) & 1)
-            sum = sum - tmp;
-        else
-            sum = sum + tmp;
-
-        power = power * square; // Next iteration is x^4
-        tmp = make((i+1) * (i+2)); // First iteration: 4 * 5
-        fact = fact * tmp;
+        // cos(a+b) = cos a cos b - sin a sin b
+        ccache &cst = constants();
+        tmp = sin_series(sum);
+        sum = cos_series(sum);
+        tmp = decimal_g(cst.sin_table(j)) * tmp;
+        sum = decimal_g(cst.cos_table(j)) * sum - tmp;
     }
+    else
+    {
+        sum = cos_series(sum);
+    }
+    if (!sum)
+        return nullptr;
 
     // sin(x+pi) = -si(x)
     if (qturns != 0)
@@ -2457,12 +2489,28 @@ decimal_p decimal::log1p(decimal_r x)
         record(decimal, "Scaled is %t, exp=%ld eexp=%ld", +scaled, texp, eexp);
     }
 
-    // If we end up with 0.999, convergence will be super slow
-    if (!scaled->is_magnitude_less_than_half())
+    // Bring values close to -1 in range using powers of e
+    scale = one + scaled;
+    texp = scale->exponent();
+    if (texp < 0)
     {
-        record(decimal, "Rescaling, %t, exp=%ld eexp=%ld ipart=%ld",
-               +scaled, texp, eexp, ipart);
+        eexp = -texp * 23 / 10;
+        power = constants().e;
+        ipart -= eexp;
+        while (eexp)
+        {
+            if (eexp & 1)
+                scale = scale * power;
+            power = power * power;
+            eexp >>= 1;
+        }
+        scaled = scale - one;
+    }
 
+    // Adjust so that scaled is between -1/2 and 1/2
+    while (!scaled->is_magnitude_less_than_half())
+    {
+        record(decimal, "Rescaling, %t, ipart=%ld", +scaled, ipart);
         scale = constants().e;
         if (scaled->is_negative())
         {
@@ -2474,38 +2522,60 @@ decimal_p decimal::log1p(decimal_r x)
             scaled = (one + scaled) / scale - one;
             ipart += 1;
         }
-    }
-
-    record(decimal, "Taylor series with %t exp=%ld eexp=%ld ipart=%ld",
-           +scaled, texp, eexp, ipart);
-
-    // Taylor's serie
-    decimal_g sum = scaled;
-    uint prec = Settings.Precision();
-    power = scaled;
-    for (uint i = 2; i < 3*prec; i++)
-    {
-        power = power * scaled;
-        scale = make(i);
-        scale = power / scale;
-
-        if (!sum || !scale)
+        if (!scaled)
             return nullptr;
+    }
 
-        // If what we add no longer has an impact, we can exit
-        if (scale->exponent() + large(prec) < sum->exponent())
-        {
-            record(decimal, "Taylor exits at %u exp=%ld", i, scale->exponent());
-            break;
-        }
-
-        if (i & 1)
-            sum = sum + scale;
+    // Estimate j = 16 * ln(1+x) with 2 * atanh(x/(2+x)) on 6 digits,
+    // truncating so that what remains has the same sign as the result
+    large j = 0;
+    decimal_g fp;
+    power = scaled * decimal_g(make(1, 6));
+    if (!power || !power->split(j, fp))
+        return nullptr;
+    large z = j * 1000000 / (2000000 + j);
+    large l = 2 * z + 2 * z * z / 1000000 * z / 3000000;
+    j = 16 * l / 1000000;
+
+    // Divide by exp(j/16) so that ln(1+scaled) is small
+    if (j)
+    {
+        // With A = exp(|j|/16)-1, (1+x)/(1+A)-1 = (x-A)/(1+A)
+        // and (1+x)*(1+A)-1 = x*A + x + A
+        scale = constants().expm1_table(j < 0 ? -j : j);
+        if (j < 0)
+            scaled = scaled * scale + scaled + scale;
         else
-            sum = sum - scale;
+            scaled = (scaled - scale) / (one + scale);
     }
-    record(decimal, "Power at exit %t exponent %ld", +power, power->exponent());
-    record(decimal, "Sum   at exit %t exponent %ld", +sum, sum->exponent());
+    record(decimal, "Series with %t ipart=%ld j=%ld", +scaled, ipart, j);
+
+    // ln(1+x) = 2 atanh(z) with z = x/(2+x), computed as Horner on z²
+    decimal_g sum;
+    decimal_g two = make(2);
+    power = scaled / (two + scaled);
+    if (!power)
+        return nullptr;
+    sum = power;
+    if (!power->is_zero())
+    {
+        uint  prec  = Settings.Precision();
+        large zexp  = power->exponent();
+        uint  terms = zexp < 0 ? (prec + 1) / uint(-2 * zexp) + 1 : prec;
+        ccache &cst = constants();
+        scale = power * power;
+        sum = cst.rodd(terms);
+        for (uint k = terms; k-- > 0; )
+            sum = sum * scale + decimal_g(cst.rodd(k));
+        sum = two * power * sum;
+    }
+    if (j)
+    {
+        scale = make(j * 625, -4);
+        sum = sum + scale;
+    }
+    if (!sum)
+        return nullptr;
 
     if (ipart)
     {
@@ -2529,32 +2599,25 @@ decimal_p decimal::expm1(decimal_r x)
     if (!x->split(ip, fp))
         return nullptr;
 
-    // Prepare power factor and square that we multiply by every time
-    decimal_g one =  make(1);
-    decimal_g sum = fp;
-    decimal_g fact = one;
-    decimal_g power = fp;
-    decimal_g tmp;
-
-    uint prec = Settings.Precision();
-    for (uint i = 2; i < prec; i++)
+    // Reduce to j/16 + r, with |r| < 1/16, using cached exp(j/16)-1
+    decimal_g one = make(1);
+    decimal_g sum, fact, power;
+    large     j   = 0;
+    fact = fp * decimal_g(make(16));
+    if (!fact || !fact->split(j, sum))
+        return nullptr;
+    sum = sum * decimal_g(make(625, -4));
+    sum = expm1_series(sum);
+    if (j)
     {
-        power = power * fp;
-        tmp = make(i);
-        fact = fact * tmp;
-
-        tmp = power / fact;     // x^2 / 2!
-
-        // Check if we ran out of memory
-        if (!sum || !tmp)
-            return nullptr;
-
-        // If what we add no longer has an impact, we can exit
-        if (tmp->exponent() + large(prec) < sum->exponent())
-            break;
-
-        sum = sum + tmp;
+        // With A = exp(a)-1, B = exp(b)-1, exp(a+b)-1 = A*B + A + B
+        fact = constants().expm1_table(j < 0 ? -j : j);
+        if (j < 0)
+            fact = -fact / (one + fact);        // exp(-a)-1 = -A/(1+A)
+        sum = fact * sum + sum + fact;
     }
+    if (!sum)
+        return nullptr;
 
     if (ip)
     {
@@ -3216,6 +3279,9 @@ decimal::ccache &decimal::constants()
         cst->oosqpi    = nullptr;
         cst->lpi       = nullptr;
         cst->precision = precision;
+        cst->tables    = nullptr;
+        for (uint i = 0; i < ccache::TABLES_SIZE; i++)
+            cst->offsets[i] = 0;
     }
     return *cst;
 }
@@ -3328,6 +3394,257 @@ decimal_g *decimal::ccache::gamma_realloc(size_t na)
 }
 
 
+decimal_p decimal::ccache::cached(uint index)
+// ----------------------------------------------------------------------------
+//   Return an entry in the tables, or nullptr if not computed yet
+// ----------------------------------------------------------------------------
+{
+    if (!tables || !offsets[index])
+        return nullptr;
+    object_p first = list_p(+tables)->objects();
+    return decimal_p(byte_p(first) + offsets[index] - 1);
+}
+
+
+void decimal::ccache::cache(uint index, decimal_r value)
+// ----------------------------------------------------------------------------
+//   Add an entry to the tables
+// ----------------------------------------------------------------------------
+//   The list is copied with the new value at the end, so that the offsets of
+//   existing entries do not change. Caching is an optimization, so it is
+//   skipped rather than causing a garbage collection or an error.
+{
+    if (!value || offsets[index])
+        return;
+
+    size_t used  = 0;
+    byte_p first = nullptr;
+    if (tables)
+        first = byte_p(list_p(+tables)->objects(&used));
+    size_t vsize = value->size();
+    if (used + 1 > 0xFFFF || rt.available() < 2 * (used + vsize) + 16)
+        return;
+
+    scribble scr;
+    if (used && !rt.append(used, first))
+        return;
+    if (!rt.append(vsize, byte_p(+value)))
+        return;
+    list_p copy = list::make(ID_list, scr.scratch(), scr.growth());
+    if (!copy)
+        return;
+    tables = copy;
+    offsets[index] = used + 1;
+}
+
+
+decimal_p decimal::ccache::rfact(uint k)
+// ----------------------------------------------------------------------------
+//   Compute and cache the reciprocal factorial 1/k!
+// ----------------------------------------------------------------------------
+{
+    if (k >= RFACT_MAX)
+    {
+        decimal_g rf = rfact(RFACT_MAX - 1);
+        decimal_g n;
+        for (uint i = RFACT_MAX; rf && i <= k; i++)
+        {
+            n = make(i);
+            rf = rf / n;
+        }
+        return rf;
+    }
+
+    if (decimal_p entry = cached(RFACT_BASE + k))
+        return entry;
+
+    decimal_g rf = make(1);
+    if (k)
+    {
+        decimal_g n = make(k);
+        rf = decimal_g(rfact(k - 1)) / n;
+    }
+    cache(RFACT_BASE + k, rf);
+    return rf;
+}
+
+
+decimal_p decimal::ccache::rodd(uint k)
+// ----------------------------------------------------------------------------
+//   Compute and cache the reciprocal 1/(2k+1)
+// ----------------------------------------------------------------------------
+//   Only the first RODD_MAX values are cached, which covers the series for
+//   logarithms up to about 120 digits. Higher precisions recompute the others.
+{
+    if (k < RODD_MAX)
+        if (decimal_p entry = cached(RODD_BASE + k))
+            return entry;
+
+    decimal_g one = make(1);
+    decimal_g n   = make(2 * k + 1);
+    one = one / n;
+    if (k < RODD_MAX)
+        cache(RODD_BASE + k, one);
+    return one;
+}
+
+
+decimal_p decimal::ccache::sin_table(uint j)
+// ----------------------------------------------------------------------------
+//   Compute and cache sin(jπ/64)
+// ----------------------------------------------------------------------------
+{
+    if (decimal_p entry = cached(SIN_BASE + j))
+        return entry;
+
+    decimal_g x = make(15625 * j, -6);
+    x = sin_series(x * pi);
+    cache(SIN_BASE + j, x);
+    return x;
+}
+
+
+decimal_p decimal::ccache::cos_table(uint j)
+// ----------------------------------------------------------------------------
+//   Compute and cache cos(jπ/64)
+// ----------------------------------------------------------------------------
+{
+    if (decimal_p entry = cached(COS_BASE + j))
+        return entry;
+
+    decimal_g x = make(15625 * j, -6);
+    x = cos_series(x * pi);
+    cache(COS_BASE + j, x);
+    return x;
+}
+
+
+decimal_p decimal::ccache::expm1_table(uint j)
+// ----------------------------------------------------------------------------
+//   Compute and cache exp(j/16)-1
+// ----------------------------------------------------------------------------
+//   Keeping exp-1 rather than exp avoids losing digits when subtracting 1
+{
+    if (decimal_p entry = cached(EXP_BASE + j))
+        return entry;
+
+    decimal_g x = make(625 * j, -4);
+    x = expm1_series(x);
+    cache(EXP_BASE + j, x);
+    return x;
+}
+
+
+uint decimal::series_order(large xexp, large digits)
+// ----------------------------------------------------------------------------
+//   Find the order m where |x|^m / m! < 10^-digits given |x| < 10^xexp
+// ----------------------------------------------------------------------------
+//   The factorial is tracked as a leading digit and a number of digits,
+//   truncating along the way, so that the result errs on the safe side
+{
+    large    d = 0;
+    uint64_t f = 1;
+    uint     m = 0;
+    while (d < digits)
+    {
+        m++;
+        d -= xexp;
+        f *= m;
+        while (f >= 10)
+        {
+            f /= 10;
+            d++;
+        }
+    }
+    return m;
+}
+
+
+decimal_p decimal::taylor(decimal_r x, uint first, uint step, uint terms)
+// ----------------------------------------------------------------------------
+//   Horner evaluation of the sum of x^i / (first + i * step)! for i < terms
+// ----------------------------------------------------------------------------
+//   Reciprocal factorials come from the constants cache. Beyond the cached
+//   range, each is derived from the next one by multiplying by an integer,
+//   so that there is no division in the loop
+{
+    if (!x || !terms)
+        return nullptr;
+
+    ccache   &cst = constants();
+    uint      k   = first + step * (terms - 1);
+    decimal_g rf  = cst.rfact(k);
+    decimal_g sum = rf;
+    decimal_g tmp;
+    for (uint i = terms - 1; i > 0; i--)
+    {
+        uint next = k - step;
+        if (next < ccache::RFACT_MAX)
+        {
+            rf = cst.rfact(next);
+        }
+        else
+        {
+            large mul = 1;
+            for (uint f = next + 1; f <= k; f++)
+                mul *= f;
+            tmp = make(mul);
+            rf = rf * tmp;
+        }
+        k = next;
+        sum = sum * x + rf;
+        if (!sum)
+            return nullptr;
+    }
+    return sum;
+}
+
+
+decimal_p decimal::sin_series(decimal_r x)
+// ----------------------------------------------------------------------------
+//   Taylor series for sin(x), for small x
+// ----------------------------------------------------------------------------
+{
+    if (!x || x->is_zero())
+        return x;
+    large     xexp  = x->exponent();
+    uint      order = series_order(xexp, Settings.Precision() + 1 - xexp);
+    decimal_g sq    = -(x * x);
+    sq = taylor(sq, 1, 2, order / 2 + 1);
+    return x * sq;
+}
+
+
+decimal_p decimal::cos_series(decimal_r x)
+// ----------------------------------------------------------------------------
+//   Taylor series for cos(x), for small x
+// ----------------------------------------------------------------------------
+{
+    if (!x)
+        return nullptr;
+    if (x->is_zero())
+        return make(1);
+    large     xexp  = x->exponent();
+    uint      order = series_order(xexp, Settings.Precision() + 1);
+    decimal_g sq    = -(x * x);
+    return taylor(sq, 0, 2, order / 2 + 1);
+}
+
+
+decimal_p decimal::expm1_series(decimal_r x)
+// ----------------------------------------------------------------------------
+//   Taylor series for exp(x)-1, for small x
+// ----------------------------------------------------------------------------
+{
+    if (!x || x->is_zero())
+        return x;
+    large     xexp  = x->exponent();
+    uint      order = series_order(xexp, Settings.Precision() + 1 - xexp);
+    decimal_g sum   = taylor(x, 1, 1, order);
+    return x * sum;
+}
+
+
 bool decimal::adjust_from_angle(uint &qturns, decimal_g &fp) const
 // ----------------------------------------------------------------------------
 //   Adjust an angle value for sin/cos/tan, qturns is number of quarter turns
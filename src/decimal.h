@@ -172,9 +172,17 @@ struct decimal : algebraic
     {
         if (x < 0)
             return rt.make<decimal>(ID_neg_decimal, -x, exp);
+        if (x <= 5)
+            if (decimal_p cst = preallocated(uint(x), exp))
+                return cst;
         return rt.make<decimal>(x, exp);
     }
 
+    static decimal_p preallocated(uint x, large exp);
+    // ------------------------------------------------------------------------
+    //   Return a read-only copy of 0, 0.5, 1 or 2 if x and exp match one
+    // ------------------------------------------------------------------------
+
 
     template<typename Int>
     static decimal_p make(id type, Int x, large exp = 0)
@@ -548,7 +556,8 @@ struct decimal : algebraic
     //  Constants are re-created whenever precision changes
     // ------------------------------------------------------------------------
     {
-        ccache(): precision(), gamma_na(0), gamma_ck(nullptr) {}
+        ccache(): precision(), gamma_na(0), gamma_ck(nullptr),
+                  tables(), offsets() {}
 
         size_t  precision;
         decimal_g pi;
@@ -570,6 +579,34 @@ struct decimal : algebraic
         decimal_g two_over_sqrt_pi();
 
         decimal_g *gamma_realloc(size_t na);
+
+        // Tables for transcendental functions, filled on demand.
+        // All entries live in a single list, so that there is only one
+        // GC-safe root, and offsets locate each entry in the list payload
+        enum
+        {
+            RFACT_MAX   = 48,   // Reciprocal factorials, 1/k!
+            SINCOS_MAX  = 17,   // sin(jπ/64) and cos(jπ/64) for j <= 16
+            EXP_MAX     = 17,   // exp(j/16)-1 for j <= 16
+            RODD_MAX    = 64,   // Reciprocals of odd numbers, 1/(2k+1)
+
+            RFACT_BASE  = 0,
+            SIN_BASE    = RFACT_BASE + RFACT_MAX,
+            COS_BASE    = SIN_BASE + SINCOS_MAX,
+            EXP_BASE    = COS_BASE + SINCOS_MAX,
+            RODD_BASE   = EXP_BASE + EXP_MAX,
+            TABLES_SIZE = RODD_BASE + RODD_MAX
+        };
+        object_g   tables;                      // List of cached entries
+        uint16_t   offsets[TABLES_SIZE];        // Offset+1 in list payload
+
+        decimal_p  cached(uint index);
+        void       cache(uint index, decimal_r value);
+        decimal_p  rfact(uint k);
+        decimal_p  rodd(uint k);
+        decimal_p  sin_table(uint j);
+        decimal_p  cos_table(uint j);
+        decimal_p  expm1_table(uint j);
     };
 
     static ccache   &constants();
@@ -583,6 +620,12 @@ struct decimal : algebraic
     bool             adjust_from_angle(uint &qturns, decimal_g &fp) const;
     decimal_p        adjust_to_angle() const;
 
+    static uint      series_order(large xexp, large digits);
+    static decimal_p taylor(decimal_r x, uint first, uint step, uint terms);
+    static decimal_p sin_series(decimal_r x);
+    static decimal_p cos_series(decimal_r x);
+    static decimal_p expm1_series(decimal_r x);
+
 public:
     OBJECT_DECL(decimal);
     PARSE_DECL(decimal);
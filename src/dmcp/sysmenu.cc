@@ -30,6 +30,7 @@
 #include "sysmenu.h"
 
 #include "file.h"
+#include "files.h"
 #include "main.h"
 #include "object.h"
 #include "program.h"
@@ -38,6 +39,7 @@
 #include "settings.h"
 #include "target.h"
 #include "types.h"
+#include "unit.h"
 #include "user_interface.h"
 #include "util.h"
 #include "variables.h"
@@ -275,6 +277,10 @@ static int state_save_callback(cstring fpath, cstring fname, void *)
     // Restore the settings we had
     Settings = saved;
 
+    // Write a binary snapshot for fast reload, once the text is complete
+    prog.close();
+    save_state_snapshot(fpath);
+
     return MRET_EXIT;
 }
 
@@ -360,6 +366,10 @@ static int state_load_callback(cstring path, cstring name, void *merge)
     ui.draw_message(merge ? "Merge state" : "Load state",
                     "Loading state...", name);
 
+    // A binary snapshot restores everything at once, but cannot merge
+    if (!merge && load_state_snapshot(path))
+        return MRET_EXIT;
+
     // Store the state file name
     file prog;
     prog.open(path);
@@ -526,6 +536,8 @@ bool load_state_file(cstring path)
     for (cstring p = path; *p; p++)
         if (*p == '/' || *p == '\\')
             name = p + 1;
+    if (load_state_snapshot(path))
+        return true;
     return state_load_callback(path, name, (void *) 1) == 0;
 }
 
@@ -740,5 +752,9 @@ void system_setup()
     CLR_ST(STAT_MENU);
     if (ret != MRET_EXIT)
         wait_for_key_release(-1);
+
+    // Files may have been changed through the USB disk
+    unit::table_invalidate();
+    ui.help_index_invalidate();
     redraw_lcd(true);
 }
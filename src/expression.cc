@@ -803,19 +803,65 @@ err:
 }
 
 
-expression_p expression::rewrite(size_t size, const byte_p rewrites[]) const
+struct operator_index
+// ----------------------------------------------------------------------------
+//   Record which object types are present at the top level of an expression
+// ----------------------------------------------------------------------------
+//   A rule can only match if the operator at the root of its pattern is
+//   present in the expression, so this lets us skip most rules in a set
+//   without expanding the expression on the stack
+{
+    operator_index(expression_p eq)
+    {
+        scan(eq);
+    }
+
+    void scan(expression_p eq)
+    {
+        memset(bits, 0, sizeof(bits));
+        for (object_p obj : *eq)
+        {
+            uint ty = obj->type();
+            bits[ty / 8] |= 1 << (ty % 8);
+        }
+    }
+
+    bool contains(object::id ty) const
+    {
+        return ty == object::ID_object || (bits[ty / 8] & (1 << (ty % 8)));
+    }
+
+    byte bits[(object::NUM_IDS + 7) / 8];
+};
+
+
+expression_p expression::rewrite(size_t size, const byte_p rewrites[],
+                                 const id leading[]) const
 // ----------------------------------------------------------------------------
 //   Apply a series of rewrites
 // ----------------------------------------------------------------------------
+//   The optional `leading` array gives the root operator of each pattern,
+//   computed at compile time by the `eq` builder
 {
-    expression_g eq = this;
+    expression_g   eq = this;
+    operator_index ops(eq);
     for (size_t i = 0; eq && i < size; i += 2)
-        eq = eq->rewrite(expression_p(rewrites[i]), expression_p(rewrites[i+1]));
+    {
+        if (leading && !ops.contains(leading[i]))
+            continue;
+
+        expression_p next = eq->rewrite(expression_p(rewrites[i]),
+                                        expression_p(rewrites[i+1]));
+        if (next && +next != +eq)
+            ops.scan(next);
+        eq = next;
+    }
     return eq;
 }
 
 
-expression_p expression::rewrite_all(size_t size, const byte_p rewrites[]) const
+expression_p expression::rewrite_all(size_t size, const byte_p rewrites[],
+                                     const id leading[]) const
 // ----------------------------------------------------------------------------
 //   Loop on the rewrites until the result stabilizes
 // ----------------------------------------------------------------------------
@@ -830,7 +876,7 @@ expression_p expression::rewrite_all(size_t size, const byte_p rewrites[]) const
             break;
 
         last = eq;
-        eq = eq->rewrite(size, rewrites);
+        eq = eq->rewrite(size, rewrites, leading);
     }
     if (count >= Settings.MaxRewrites())
         rt.too_many_rewrites_error();
@@ -88,8 +88,10 @@ struct expression : program
     {
         return rewrite(expression_g(from), expression_g(to));
     }
-    expression_p rewrite(size_t size, const byte_p rewrites[]) const;
-    expression_p rewrite_all(size_t size, const byte_p rewrites[]) const;
+    expression_p rewrite(size_t size, const byte_p rewrites[],
+                         const id leading[] = nullptr) const;
+    expression_p rewrite_all(size_t size, const byte_p rewrites[],
+                             const id leading[] = nullptr) const;
 
     static expression_p rewrite(expression_r eq, expression_r from, expression_r to)
     {
@@ -100,14 +102,16 @@ struct expression : program
     expression_p rewrite(args... rest) const
     {
         static constexpr byte_p rewrites[] = { rest.as_bytes()... };
-        return rewrite(sizeof...(rest), rewrites);
+        static constexpr id     leading[]  = { args::leading()... };
+        return rewrite(sizeof...(rest), rewrites, leading);
     }
 
     template <typename ...args>
     expression_p rewrite_all(args... rest) const
     {
         static constexpr byte_p rewrites[] = { rest.as_bytes()... };
-        return rewrite_all(sizeof...(rest), rewrites);
+        static constexpr id     leading[]  = { args::leading()... };
+        return rewrite_all(sizeof...(rest), rewrites, leading);
     }
 
     expression_p expand() const;
@@ -174,6 +178,16 @@ struct eq
     {
         return expression_p(object_data);
     }
+    static constexpr object::id leading()
+    {
+        // Operator at the root of the pattern, ID_object for a single leaf
+        return ((sizeof...(args) == 3 && object_data[2] == object::ID_symbol) ||
+                (sizeof...(args) == 2 &&
+                 (object_data[2] == object::ID_integer ||
+                  object_data[2] == object::ID_neg_integer)))
+            ? object::ID_object
+            : object::id(object_data[sizeof...(args) + 1]);
+    }
 
     // Negation operation
     eq<args..., object::ID_neg>
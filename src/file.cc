@@ -34,6 +34,7 @@
 #include "text.h"
 #include "utf8.h"
 
+#include <sys/stat.h>
 #include <unistd.h>
 
 
@@ -49,39 +50,16 @@ RECORDER(file_error,    16, "File errors");
 //
 // ============================================================================
 
-#ifndef SIMULATOR
-static inline int fgetc(FIL &f)
-// ----------------------------------------------------------------------------
-//   Read one character from a file - Wrapper for DMCP filesystem
-// ----------------------------------------------------------------------------
-{
-    UINT br                     = 0;
-    char c                      = 0;
-    if (f_read(&f, &c, 1, &br) != FR_OK || br != 1)
-        return EOF;
-    return c;
-}
-
-
-static inline int fputc(int c, FIL &f)
-// ----------------------------------------------------------------------------
-//   Read one character from a file - Wrapper for DMCP filesystem
-// ----------------------------------------------------------------------------
-{
-    UINT bw = 0;
-    if (f_write(&f, &c, 1, &bw) != FR_OK || bw != 1)
-        return EOF;
-    return c;
-}
-#endif                          // SIMULATOR
-
+uint file::reads  = 0;
+uint file::writes = 0;
+uint file::seeks  = 0;
 
 
 file::file()
 // ----------------------------------------------------------------------------
 //   Construct a file object
 // ----------------------------------------------------------------------------
-    : data()
+    : data(), bufpos(), buflen(), bufidx(), physical(), writing()
 {}
 
 
@@ -89,7 +67,7 @@ file::file(cstring path, bool writing)
 // ----------------------------------------------------------------------------
 //   Construct a file object for writing
 // ----------------------------------------------------------------------------
-    : data()
+    : data(), bufpos(), buflen(), bufidx(), physical(), writing()
 {
     if (writing)
         open_for_writing(path);
@@ -102,7 +80,7 @@ file::file(text_p name, bool writing)
 // ----------------------------------------------------------------------------
 //   Open a file from a text value
 // ----------------------------------------------------------------------------
-    : data()
+    : data(), bufpos(), buflen(), bufidx(), physical(), writing()
 {
     char   buf[80];
     size_t len  = 0;
@@ -137,6 +115,8 @@ void file::open(cstring path)
 //    Open a file for reading
 // ----------------------------------------------------------------------------
 {
+    bufpos = buflen = bufidx = physical = 0;
+    writing = false;
 #if SIMULATOR
     data = fopen(path, "r");
     if (!data)
@@ -155,6 +135,8 @@ void file::open_for_writing(cstring path)
 //    Open a file for writing
 // ----------------------------------------------------------------------------
 {
+    bufpos = buflen = bufidx = physical = 0;
+    writing = true;
 #if SIMULATOR
     data = fopen(path, "w");
     if (!data)
@@ -176,14 +158,29 @@ void file::open_for_writing(cstring path)
 }
 
 
-void file::close()
+bool file::close()
 // ----------------------------------------------------------------------------
-//    Close the help file
+//    Close the help file, return false if pending data could not be written
 // ----------------------------------------------------------------------------
 {
+    bool ok = true;
     if (valid())
     {
-        fclose(data);
+        if (writing)
+            ok = flush();
+#if SIMULATOR
+        ok = fclose(data) == 0 && ok;
+#else
+        // Keep an error code that file::error() can report
+        FRESULT closed = fclose(data);
+        if (closed != FR_OK)
+            data.err = closed;
+        else if (!ok)
+            data.err = FR_DISK_ERR;
+        ok = closed == FR_OK && ok;
+#endif // SIMULATOR
+        record(file, "Closed after %u reads, %u writes, %u seeks",
+               reads, writes, seeks);
 
 #if SIMULATOR
         data = nullptr;
@@ -192,37 +189,103 @@ void file::close()
         data.flag = 0;
 #endif // SIMULATOR
     }
+    bufpos = buflen = bufidx = physical = 0;
+    return ok;
 }
 
 
-bool file::put(unicode cp)
+uint32_t file::modified()
 // ----------------------------------------------------------------------------
-//   Emit a unicode character in the file
+//   Return a modification stamp for the file, 0 if not available
 // ----------------------------------------------------------------------------
+//   DMCP does not expose f_stat, so on the calculator, callers need some
+//   other way to detect changes, e.g. a checksum
 {
-    byte   buffer[4];
-    size_t count = utf8_encode(cp, buffer);
+#if SIMULATOR
+    struct stat st;
+    if (valid() && fstat(fileno(data), &st) == 0)
+        return uint32_t(st.st_mtime) | 1;
+#endif // SIMULATOR
+    return 0;
+}
+
+
+bool file::fill(uint offset)
+// ----------------------------------------------------------------------------
+//   Read the block containing the given offset into the buffer
+// ----------------------------------------------------------------------------
+//   Blocks are aligned, so that scanning backwards with `rfind` does not
+//   reload the buffer for each character
+{
+    if (!valid() || writing)
+        return false;
 
+    uint start = offset - offset % BUFFER_SIZE;
+    if (start != physical)
+    {
+        seeks++;
+        fseek(data, start, SEEK_SET);
+        physical = start;
+    }
+
+    reads++;
 #if SIMULATOR
-    return fwrite(buffer, 1, count, data) == count;
+    size_t got = fread(buffer, 1, BUFFER_SIZE, data);
 #else
-    UINT bw = 0;
-    return f_write(&data, buffer, count, &bw) == FR_OK && bw == count;
+    UINT got = 0;
+    if (f_read(&data, buffer, BUFFER_SIZE, &got) != FR_OK)
+        got = 0;
 #endif
+    physical += got;
+    bufpos = start;
+    buflen = got;
+    bufidx = offset - start;
+    return bufidx < buflen;
 }
 
 
-bool file::put(char c)
+bool file::flush()
 // ----------------------------------------------------------------------------
-//   Emit a single character in the file
+//   Write pending data in the buffer
 // ----------------------------------------------------------------------------
 {
+    if (!buflen)
+        return true;
+
+    writes++;
 #if SIMULATOR
-    return fwrite(&c, 1, 1, data) == 1;
+    bool ok = fwrite(buffer, 1, buflen, data) == buflen;
 #else
     UINT bw = 0;
-    return f_write(&data, &c, 1, &bw) == FR_OK && bw == 1;
+    bool ok = f_write(&data, buffer, buflen, &bw) == FR_OK && bw == buflen;
 #endif
+    bufpos += buflen;
+    physical = bufpos;
+    buflen = 0;
+    return ok;
+}
+
+
+bool file::put(unicode cp)
+// ----------------------------------------------------------------------------
+//   Emit a unicode character in the file
+// ----------------------------------------------------------------------------
+{
+    byte   buffer[4];
+    size_t count = utf8_encode(cp, buffer);
+    return write(cstring(buffer), count);
+}
+
+
+bool file::put(char c)
+// ----------------------------------------------------------------------------
+//   Emit a single character in the file
+// ----------------------------------------------------------------------------
+{
+    if (buflen >= BUFFER_SIZE && !flush())
+        return false;
+    buffer[buflen++] = c;
+    return true;
 }
 
 
@@ -231,12 +294,30 @@ bool file::write(const char *buf, size_t len)
 //   Emit a buffer to a file
 // ----------------------------------------------------------------------------
 {
+    // Small writes are accumulated in the buffer
+    if (buflen + len <= BUFFER_SIZE)
+    {
+        memcpy(buffer + buflen, buf, len);
+        buflen += len;
+        return true;
+    }
+
+    // Large writes go directly to the file once the buffer is flushed
+    if (!flush())
+        return false;
+    if (len < BUFFER_SIZE)
+        return write(buf, len);
+
+    writes++;
 #if SIMULATOR
-    return fwrite(buf, 1, len, data) == len;
+    bool ok = fwrite(buf, 1, len, data) == len;
 #else
     UINT bw = 0;
-    return f_write(&data, buf, len, &bw) == FR_OK && bw == len;
+    bool ok = f_write(&data, buf, len, &bw) == FR_OK && bw == len;
 #endif
+    bufpos += len;
+    physical = bufpos;
+    return ok;
 }
 
 
@@ -245,12 +326,47 @@ bool file::read(char *buf, size_t len)
 //   Read data from a file
 // ----------------------------------------------------------------------------
 {
+    while (len)
+    {
+        // Copy what we have in the buffer
+        if (bufidx < buflen)
+        {
+            size_t avail = buflen - bufidx;
+            size_t count = avail < len ? avail : len;
+            memcpy(buf, buffer + bufidx, count);
+            bufidx += count;
+            buf += count;
+            len -= count;
+            continue;
+        }
+
+        // Large reads go directly to the destination
+        uint offset = bufpos + bufidx;
+        if (len >= BUFFER_SIZE && offset % BUFFER_SIZE == 0)
+        {
+            if (offset != physical)
+            {
+                seeks++;
+                fseek(data, offset, SEEK_SET);
+            }
+            reads++;
 #if SIMULATOR
-    return fread(buf, 1, len, data) == len;
+            size_t got = fread(buf, 1, len, data);
 #else
-    UINT bw = 0;
-    return f_read(&data, buf, len, &bw) == FR_OK && bw == len;
+            UINT got = 0;
+            if (f_read(&data, buf, len, &got) != FR_OK)
+                got = 0;
 #endif
+            physical = offset + got;
+            bufpos = physical;
+            buflen = bufidx = 0;
+            return got == len;
+        }
+
+        if (!fill(offset))
+            return false;
+    }
+    return true;
 }
 
 
@@ -259,7 +375,7 @@ char file::getchar()
 //   Read char code at offset
 // ----------------------------------------------------------------------------
 {
-    int c = valid() ? fgetc(data) : 0;
+    int c = next();
     if (c == EOF)
         c = 0;
     return c;
@@ -271,7 +387,7 @@ unicode file::get()
 //   Read UTF8 code at offset
 // ----------------------------------------------------------------------------
 {
-    unicode code = valid() ? fgetc(data) : unicode(EOF);
+    unicode code = next();
     if (code == unicode(EOF))
         return 0;
 
@@ -280,16 +396,16 @@ unicode file::get()
         // Reference: Wikipedia UTF-8 description
         if ((code & 0xE0)      == 0xC0)
             code = ((code & 0x1F)        <<  6)
-                |  (fgetc(data) & 0x3F);
+                |  (next() & 0x3F);
         else if ((code & 0xF0) == 0xE0)
             code = ((code & 0xF)         << 12)
-                |  ((fgetc(data) & 0x3F) <<  6)
-                |   (fgetc(data) & 0x3F);
+                |  ((next() & 0x3F) <<  6)
+                |   (next() & 0x3F);
         else if ((code & 0xF8) == 0xF0)
             code = ((code & 0xF)         << 18)
-                |  ((fgetc(data) & 0x3F) << 12)
-                |  ((fgetc(data) & 0x3F) << 6)
-                |   (fgetc(data) & 0x3F);
+                |  ((next() & 0x3F) << 12)
+                |  ((next() & 0x3F) << 6)
+                |   (next() & 0x3F);
     }
     return code;
 }
@@ -305,7 +421,7 @@ uint file::find(unicode   cp)
     uint    off;
     do
     {
-        off          = ftell(data);
+        off          = position();
         c            = get();
     } while (c && c != cp);
     return off;
@@ -318,13 +434,13 @@ uint file::rfind(unicode  cp)
 // ----------------------------------------------------------------------------
 //    Return position right before code point, position file right after it
 {
-    uint    off = ftell(data);
+    uint    off = position();
     unicode c;
     do
     {
         if (off == 0)
             break;
-        fseek(data, --off, SEEK_SET);
+        seek(--off);
         c        = get();
     }
     while (c != cp);
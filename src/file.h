@@ -43,6 +43,11 @@ struct file
 // ----------------------------------------------------------------------------
 //   Direct access to the help file
 // ----------------------------------------------------------------------------
+//   Accesses go through a block buffer, so that reading or writing one
+//   character at a time does not cost one filesystem call per byte.
+//   When reading, the buffer holds the block at [bufpos, bufpos+buflen),
+//   and bufidx is the current position in it. When writing, the buffer
+//   holds buflen pending bytes to be written at file offset bufpos.
 {
     file();
     file(cstring path, bool writing);
@@ -53,7 +58,7 @@ struct file
     void    open_for_writing(cstring path);
     bool    valid();
     bool    eof();
-    void    close();
+    bool    close();
     bool    put(unicode out);
     bool    put(char c);
     bool    write(const char *buf, size_t len);
@@ -64,6 +69,8 @@ struct file
     void    seek(uint offset);
     unicode peek();
     uint    position();
+    uint    size();
+    uint32_t modified();
     uint    find(unicode cp);
     uint    rfind(unicode cp);
     cstring error(int err) const;
@@ -72,12 +79,33 @@ struct file
     static  bool unlink(text_p path);
     static  bool unlink(cstring path);
 
+    // Count of underlying filesystem calls, to measure buffering
+    static uint reads, writes, seeks;
+    static uint calls()         { return reads + writes + seeks; }
+
 protected:
+    enum { BUFFER_SIZE = 256 };
+
+    bool    fill(uint offset);
+    bool    flush();
+    int     next()
+    {
+        if (bufidx >= buflen && !fill(bufpos + bufidx))
+            return EOF;
+        return byte(buffer[bufidx++]);
+    }
+
 #if SIMULATOR
     FILE *data;
 #else
     FIL     data;
 #endif
+    uint    bufpos;             // File offset of the buffer
+    uint    buflen;             // Bytes valid or pending in buffer
+    uint    bufidx;             // Read position in the buffer
+    uint    physical;           // Position of the underlying file
+    bool    writing;            // Buffer holds data to write
+    char    buffer[BUFFER_SIZE];
 };
 
 
@@ -122,8 +150,28 @@ inline void file::seek(uint off)
 // ----------------------------------------------------------------------------
 //    Move the read position in the data file
 // ----------------------------------------------------------------------------
+//    Seeking within the current buffer does not touch the filesystem
 {
-    fseek(data, off, SEEK_SET);
+    if (writing)
+    {
+        if (off == bufpos + buflen)
+            return;
+        flush();
+        seeks++;
+        fseek(data, off, SEEK_SET);
+        bufpos = physical = off;
+    }
+    else if (off >= bufpos && off <= bufpos + buflen)
+    {
+        bufidx = off - bufpos;
+    }
+    else
+    {
+        // Will fill from the new position on next read
+        bufpos = off;
+        buflen = 0;
+        bufidx = 0;
+    }
 }
 
 
@@ -132,7 +180,7 @@ inline unicode file::peek()
 //    Look at what is as current position without moving it
 // ----------------------------------------------------------------------------
 {
-    uint off       = ftell(data);
+    uint off       = position();
     unicode result = get();
     seek(off);
     return result;
@@ -154,7 +202,26 @@ inline uint file::position()
 //   Return current position in help file
 // ----------------------------------------------------------------------------
 {
-    return ftell(data);
+    return writing ? bufpos + buflen : bufpos + bufidx;
+}
+
+
+inline uint file::size()
+// ----------------------------------------------------------------------------
+//   Return the size of the file
+// ----------------------------------------------------------------------------
+{
+    if (writing)
+        flush();
+#if SIMULATOR
+    seeks += 2;
+    fseek(data, 0, SEEK_END);
+    uint result = ftell(data);
+    fseek(data, physical, SEEK_SET);
+    return result;
+#else
+    return f_size(&data);
+#endif
 }
 
 
@@ -163,7 +230,9 @@ inline bool file::eof()
 //   Indicate if end of file
 // ----------------------------------------------------------------------------
 {
-    return feof(data);
+    if (writing)
+        return false;
+    return bufidx >= buflen && !fill(bufpos + bufidx);
 }
 
 #endif // FILE_H
@@ -35,6 +35,7 @@
 #include "program.h"
 #include "runtime.h"
 #include "settings.h"
+#include "variables.h"
 
 #include <dmcp.h>
 
@@ -130,7 +131,8 @@ bool files::store_binary(text_p name, object_p value) const
             uint32_t checksum = id_checksum();
             if (f.write(cstring(file_magic), sizeof(file_magic))    &&
                 f.write(cstring(&checksum), sizeof(checksum))       &&
-                f.write(cstring(value), value->size()))
+                f.write(cstring(value), value->size())          &&
+                f.close())
                 return true;
         }
         rt.error(f.error());
@@ -152,7 +154,7 @@ bool files::store_source(text_p name, object_p value) const
             text_p source = value->as_text(true, false);
             size_t len = 0;
             utf8   txt    = source->value(&len);
-            if (f.write(cstring(txt), len))
+            if (f.write(cstring(txt), len) && f.close())
                 return true;
         }
         rt.error(f.error());
@@ -173,7 +175,7 @@ bool files::store_text(text_p name, text_p value) const
         {
             size_t len = 0;
             utf8   txt    = value->value(&len);
-            if (f.write(cstring(txt), len))
+            if (f.write(cstring(txt), len) && f.close())
                 return true;
         }
         rt.error(f.error());
@@ -232,7 +234,7 @@ bool files::store_list(text_p name, list_p value) const
                 if (!ok)
                     break;
             }
-            if (ok)
+            if (ok && f.close())
                 return true;
         }
         rt.error(f.error());
@@ -605,3 +607,216 @@ text_p files::filename(text_p name, bool writing) const
     text_g path = name;
     return base + sep + path;
 }
+
+
+
+// ============================================================================
+//
+//   Binary state snapshots
+//
+// ============================================================================
+//   A snapshot is written next to each .48S state file, with a .48I extension.
+//   It contains an image of the home directory, the stack, the settings and
+//   the current path, so that a state can be restored with a few bulk reads
+//   instead of parsing and running the source. The size and a checksum of the
+//   .48S file are recorded, so that a state edited on disk makes the snapshot
+//   stale, even if its size did not change.
+//   The text state remains the reference, and is used whenever the snapshot
+//   is missing, stale or comes from a build with different object IDs.
+
+struct snapshot_header
+// ----------------------------------------------------------------------------
+//   Header that follows the magic number and ID checksum in a snapshot
+// ----------------------------------------------------------------------------
+{
+    uint32_t source;            // Size of the matching .48S file
+    uint32_t sum;               // Checksum of the matching .48S file
+    uint32_t settings;          // Size of the settings structure
+    uint32_t globals;           // Size of the home directory
+    uint32_t stack;             // Total size of the stack objects
+    uint32_t depth;             // Number of stack objects
+    uint32_t path;              // Size of the current path
+};
+
+
+static bool snapshot_name(cstring state, char *buf, size_t size)
+// ----------------------------------------------------------------------------
+//   Build the snapshot name by replacing the .48S extension of a state file
+// ----------------------------------------------------------------------------
+{
+    size_t len = strlen(state);
+    if (len < 4 || len >= size || strcasecmp(state + len - 4, ".48S") != 0)
+        return false;
+    memcpy(buf, state, len + 1);
+    buf[len - 1] = 'I';
+    return true;
+}
+
+
+static uint32_t state_source_sum(cstring state, uint32_t *size)
+// ----------------------------------------------------------------------------
+//   Return the size and checksum of the .48S file, size is 0 on error
+// ----------------------------------------------------------------------------
+{
+    file     source;
+    uint32_t sum = 0;
+    *size = 0;
+    source.open(state);
+    if (!source.valid())
+        return 0;
+
+    uint32_t length = source.size();
+    byte     buffer[256];
+    for (uint32_t done = 0; done < length; done += sizeof(buffer))
+    {
+        size_t count = length - done;
+        if (count > sizeof(buffer))
+            count = sizeof(buffer);
+        if (!source.read((char *) buffer, count))
+            return 0;
+        for (size_t i = 0; i < count; i++)
+            sum = 0x1081 * sum ^ buffer[i];
+    }
+    *size = length;
+    return sum;
+}
+
+
+bool save_state_snapshot(cstring state)
+// ----------------------------------------------------------------------------
+//   Write a binary snapshot of the current state next to the .48S file
+// ----------------------------------------------------------------------------
+{
+    char name[80];
+    if (!snapshot_name(state, name, sizeof(name)))
+        return false;
+
+    snapshot_header header;
+    header.sum = state_source_sum(state, &header.source);
+    if (!header.source)
+        return false;
+
+    // Build the path before taking raw pointers, since this may GC
+    list_g path = directory::path(object::ID_block);
+    if (!path)
+        return false;
+
+    directory_p home = rt.homedir();
+    header.settings  = sizeof(Settings);
+    header.globals   = home->size();
+    header.depth     = rt.depth();
+    header.stack     = 0;
+    for (uint d = 0; d < header.depth; d++)
+        header.stack += rt.stack(d)->size();
+    header.path      = path->size();
+
+    file f(name, true);
+    if (!f.valid())
+        return false;
+
+    uint32_t checksum = id_checksum();
+    bool ok = f.write(cstring(file_magic), sizeof(file_magic))   &&
+              f.write(cstring(&checksum), sizeof(checksum))      &&
+              f.write(cstring(&header), sizeof(header))          &&
+              f.write(cstring(&Settings), sizeof(Settings))      &&
+              f.write(cstring(home), header.globals);
+    for (uint d = header.depth; ok && d > 0; d--)
+    {
+        object_p obj = rt.stack(d - 1);
+        ok = f.write(cstring(obj), obj->size());
+    }
+    ok = ok && f.write(cstring(+path), header.path);
+    ok = f.close() && ok;
+
+    // Do not leave a truncated snapshot behind
+    if (!ok)
+        file::unlink(name);
+    return ok;
+}
+
+
+bool load_state_snapshot(cstring state)
+// ----------------------------------------------------------------------------
+//   Replace the current state with the snapshot matching a .48S file
+// ----------------------------------------------------------------------------
+//   On failure, the runtime is left in a clean state for the text fallback
+{
+    char name[80];
+    if (!snapshot_name(state, name, sizeof(name)))
+        return false;
+
+    file f;
+    f.open(name);
+    if (!f.valid())
+        return false;
+
+    byte            magic[sizeof(file_magic)];
+    uint32_t        checksum = 0;
+    snapshot_header header;
+    settings        loaded;
+    if (!f.read((char *) magic, sizeof(magic))                  ||
+        memcmp(magic, file_magic, sizeof(file_magic)) != 0      ||
+        !f.read((char *) &checksum, sizeof(checksum))           ||
+        checksum != id_checksum()                               ||
+        !f.read((char *) &header, sizeof(header))               ||
+        header.settings != sizeof(loaded)                       ||
+        !f.read((char *) &loaded, sizeof(loaded)))
+        return false;
+
+    // Only one file can be open at a time on DM42, so remember the position
+    uint     offset = f.position();
+    uint32_t size   = 0;
+    f.close();
+    if (state_source_sum(state, &size) != header.sum || size != header.source)
+        return false;
+    f.open(name);
+    if (!f.valid())
+        return false;
+    f.seek(offset);
+
+    // Read the home directory directly in place
+    byte *globals = rt.replace_globals(header.globals);
+    if (!globals)
+        return false;
+    directory_p home = directory_p(globals);
+    size_t      room = 0;
+    size_t      need = 0;
+    byte       *data = nullptr;
+    object_p    obj  = nullptr;
+    object_p    last = nullptr;
+    if (!f.read((char *) globals, header.globals)               ||
+        home->type() != object::ID_directory                    ||
+        home->size() != header.globals)
+        goto fail;
+
+    // Read stack objects and path as a single block of temporaries
+    room = header.stack + header.path;
+    need = room + header.depth * sizeof(object_p);
+    if (rt.available(need) < need)
+        goto fail;
+    data = rt.allocate(room);
+    if (!data || !f.read((char *) data, room))
+        goto fail;
+    obj = rt.temporary();
+    last = object_p(byte_p(obj) + header.stack);
+    for (uint d = 0; d < header.depth; d++)
+    {
+        if (obj >= last || obj->type() >= object::NUM_IDS || !rt.push(obj))
+            goto fail;
+        obj = obj->skip();
+    }
+    if (obj != last ||
+        obj->type() != object::ID_block || obj->size() != header.path)
+        goto fail;
+
+    // Restore settings, then the current directory
+    Settings = loaded;
+    if (program::run(obj) != object::OK)
+        goto fail;
+    return true;
+
+fail:
+    rt.reset();
+    rt.clear_error();
+    return false;
+}
@@ -87,6 +87,10 @@ struct files : text
     text_p   filename(text_p name, bool writing = false) const;
 };
 
+// Binary snapshots of the calculator state, stored next to a .48S file
+bool save_state_snapshot(cstring state);
+bool load_state_snapshot(cstring state);
+
 // Marker for valid binary files
 #define DB48X_MAGIC     { 0xDB, 0x48, 0x17, 0x02 }
 #define DB50X_MAGIC     { 0xDB, 0x50, 0x19, 0x69 }
@@ -147,7 +147,7 @@ integer_g fraction::numerator(int) const
     id ty = (type() == ID_neg_fraction) ? ID_neg_integer : ID_integer;
     byte_p p = payload();
     ularge nv = leb128<ularge>(p);
-    return rt.make<integer>(ty, nv);
+    return integer::make(ty, nv);
 }
 
 
@@ -159,7 +159,7 @@ integer_g fraction::denominator(int) const
     byte_p p = payload();
     ularge nv = leb128<ularge>(p);
     ularge dv = leb128<ularge>(p) + 0 * nv;
-    return rt.make<integer>(ID_integer, dv);
+    return integer::make(ID_integer, dv);
 }
 
 
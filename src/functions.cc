@@ -517,7 +517,7 @@ FUNCTION_BODY(inv)
 
     if (x->is_decimal())
         return decimal::inv(decimal_p(+x));
-    algebraic_g one = rt.make<integer>(ID_integer, 1);
+    algebraic_g one = integer::make(1);
     return one / x;
 }
 
@@ -548,7 +548,7 @@ FUNCTION_BODY(neg)
     }
     if (x->is_symbolic())
         return symbolic(ID_neg, x);
-    algebraic_g zero = rt.make<integer>(ID_integer, 0);
+    algebraic_g zero = integer::make(0);
     return zero - x;
 }
 
@@ -52,6 +52,49 @@ SIZE_BODY(integer)
 }
 
 
+struct small_integers
+// ----------------------------------------------------------------------------
+//   Read-only table of pre-encoded integers in [SMALL_MIN, SMALL_MAX]
+// ----------------------------------------------------------------------------
+//   Each entry is the LEB128 type followed by the LEB128 magnitude, padded
+//   to a fixed stride so that lookup is a simple multiplication
+{
+    enum
+    {
+        STRIDE = 4,
+        COUNT  = integer::SMALL_MAX - integer::SMALL_MIN + 1
+    };
+
+    constexpr small_integers(): bytes()
+    {
+        for (int i = 0; i < COUNT; i++)
+        {
+            int        v    = i + integer::SMALL_MIN;
+            object::id type = v < 0 ? object::ID_neg_integer
+                                    : object::ID_integer;
+            byte      *p    = bytes + i * STRIDE;
+            p = leb128_constexpr(p, type);
+            leb128_constexpr(p, v < 0 ? -v : v);
+        }
+    }
+
+    byte bytes[COUNT * STRIDE];
+};
+
+static constexpr small_integers small_integer_table;
+static_assert(object::NUM_IDS < 16384, "Small integer table stride");
+
+
+integer_p integer::preallocated(large value)
+// ----------------------------------------------------------------------------
+//   Return a preallocated integer for a small value
+// ----------------------------------------------------------------------------
+{
+    size_t index = (value - SMALL_MIN) * small_integers::STRIDE;
+    return integer_p(small_integer_table.bytes + index);
+}
+
+
 HELP_BODY(integer)
 // ----------------------------------------------------------------------------
 //   Help topic for integers
@@ -349,7 +392,7 @@ PARSE_BODY(integer)
         // Create the intermediate result, which may GC
         {
             gcutf8 gs = s;
-            number = big ? object_p(bresult) : rt.make<integer>(type, result);
+            number = big ? object_p(bresult) : integer::make(type, result);
             s = gs;
         }
         if (!number)
@@ -112,6 +112,25 @@ struct integer : algebraic
     template <typename Int>
     static integer_p make(Int value);
 
+    static integer_p make(id type, ularge value)
+    // ------------------------------------------------------------------------
+    //   Make an integer of the given type, sharing preallocated small values
+    // ------------------------------------------------------------------------
+    {
+        if (value <= SMALL_MAX)
+        {
+            if (type == ID_integer)
+                return preallocated(value);
+            if (type == ID_neg_integer && value && value <= -SMALL_MIN)
+                return preallocated(-large(value));
+        }
+        return rt.make<integer>(type, value);
+    }
+
+    // Range of values preallocated in a read-only table
+    enum { SMALL_MIN = -128, SMALL_MAX = 1023 };
+    static integer_p preallocated(large value);
+
     // Up to 63 bits, we use native functions, it's faster
     enum { NATIVE = 64 / 7 };
     static bool native(byte_p x)        { return leb128size(x) <= NATIVE; }
@@ -158,6 +177,9 @@ integer_p integer::make(Int value)
 //   Make an integer with the correct sign
 // ----------------------------------------------------------------------------
 {
+    if (value > Int(0) ? ularge(value) <= ularge(SMALL_MAX)
+                       : large(value) >= large(SMALL_MIN))
+        return preallocated(large(value));
     return value < 0 ? rt.make<neg_integer>(-value) : rt.make<integer>(value);
 }
 
@@ -43,6 +43,9 @@
 RECORDER(integrate, 16, "Numerical integration");
 RECORDER(integrate_error, 16, "Numerical integrationsol");
 
+// Number of integrand evaluations during the last integration
+uint integrate_evaluations = 0;
+
 
 COMMAND_BODY(Integrate)
 // ----------------------------------------------------------------------------
@@ -92,11 +95,50 @@ COMMAND_BODY(Integrate)
 }
 
 
+COMMAND_BODY(IntegrationEvaluations)
+// ----------------------------------------------------------------------------
+//   Return the number of evaluations of the integrand in last integration
+// ----------------------------------------------------------------------------
+{
+    if (rt.args(0))
+        if (integer_p ev = integer::make(integrate_evaluations))
+            if (rt.push(ev))
+                return OK;
+    return ERROR;
+}
+
+
+static inline algebraic_p integrand(program_r eq, algebraic_r x)
+// ----------------------------------------------------------------------------
+//   Evaluate the integrand, counting evaluations
+// ----------------------------------------------------------------------------
+{
+    integrate_evaluations++;
+    return algebraic::evaluate_function(eq, x);
+}
+
+
 algebraic_p integrate(program_g   eq,
                       symbol_g    name,
                       algebraic_g lx,
                       algebraic_g hx)
 // ----------------------------------------------------------------------------
+//   Select the integration method based on settings
+// ----------------------------------------------------------------------------
+{
+    record(integrate, "Initial range %t-%t", +lx, +hx);
+
+    // Set independent variable
+    save<symbol_g *> iref(expression::independent, &name);
+    integrate_evaluations = 0;
+    if (Settings.TanhSinhIntegration())
+        return tanh_sinh_integrate(eq, lx, hx);
+    return romberg_integrate(eq, lx, hx);
+}
+
+
+algebraic_p romberg_integrate(program_r eq, algebraic_r lx, algebraic_r hx)
+// ----------------------------------------------------------------------------
 //   Romberg algorithm - The core of the integration function
 // ----------------------------------------------------------------------------
 //   The Romberg algorithm uses two buffers, one keeping the approximations
@@ -111,17 +153,13 @@ algebraic_p integrate(program_g   eq,
     algebraic_g two  = integer::make(2);
     algebraic_g four = integer::make(4);
     algebraic_g pow4;
-    record(integrate, "Initial range %t-%t", +lx, +hx);
-
-    // Set independent variable
-    save<symbol_g *> iref(expression::independent, &name);
     int              prec = Settings.IntegratePrecision();
     algebraic_g      eps = decimal::make(1, -prec);
 
     // Initial integration step and first trapezoidal step
     dx              = hx - lx;
-    sy              = algebraic::evaluate_function(eq, lx);
-    sy2             = algebraic::evaluate_function(eq, hx);
+    sy              = integrand(eq, lx);
+    sy2             = integrand(eq, hx);
     sy              = (sy + sy2) * dx / two;
     if (!dx || !sy)
         return nullptr;
@@ -150,7 +188,7 @@ algebraic_p integrate(program_g   eq,
                 goto error;
 
             // Evaluate equation
-            y  = algebraic::evaluate_function(eq, x);
+            y  = integrand(eq, x);
 
             // Sum elements, and approximate when necessary
             sy = sy + y;
@@ -229,3 +267,160 @@ error:
     rt.drop(rt.depth() - depth);
     return nullptr;
 }
+
+
+algebraic_p tanh_sinh_integrate(program_r eq, algebraic_r lx, algebraic_r hx)
+// ----------------------------------------------------------------------------
+//   Tanh-sinh (double exponential) quadrature
+// ----------------------------------------------------------------------------
+//   The substitution x = c + d * tanh(π/2 * sinh t) maps the interval on the
+//   whole real line, with weights w(t) = π/2 * cosh t / cosh²(π/2 * sinh t)
+//   that decay double-exponentially. A trapezoidal sum on t then converges
+//   very quickly, even with singularities at the ends, which are never used.
+//   Each level halves the step h, and only evaluates at odd multiples of h,
+//   so that the sum carries over all evaluations from the previous levels.
+//   Near the ends, x is computed from 1 - tanh(u) = 2 / (exp(2u) + 1) to
+//   avoid losing the small offset to cancellation.
+{
+    const uint  TMAX  = 6;      // Truncation of t range at the first level
+    const uint  GUARD = 6;      // Guard digits beyond IntegratePrecision
+
+    // Abscissas and weights only need a few more digits than the result
+    uint digits = Settings.IntegratePrecision() + GUARD;
+    if (digits > Settings.Precision())
+        digits = Settings.Precision();
+    settings::SavePrecision saved_precision(digits);
+
+    algebraic_g one   = integer::make(1);
+    algebraic_g two   = integer::make(2);
+    algebraic_g dx    = (hx - lx) / two;
+    algebraic_g hpi   = algebraic::pi() / two;
+    int         prec  = Settings.IntegratePrecision();
+    algebraic_g eps   = decimal::make(1, -prec);
+    algebraic_g tiny  = eps * eps;
+    algebraic_g h     = one;
+    algebraic_g x, y, sum, est, last, limit;
+    algebraic_g et, es, ch, u2, e2u, w, off;
+    uint        max   = Settings.IntegratePrecision();
+    uint        count = TMAX;
+    if (!dx || !hpi || !tiny)
+        return nullptr;
+
+    // Center point, where the weight is π/2
+    x = (lx + hx) / two;
+    y = x ? integrand(eq, x) : nullptr;
+    sum = y ? y * hpi : nullptr;
+    if (!sum)
+        return nullptr;
+
+    for (uint level = 0; level <= max && !program::interrupted(); level++)
+    {
+        // Level 0 evaluates at all multiples of h, then only at odd ones
+        et = exp::evaluate(h);
+        es = level ? et * et : et;
+        if (!et || !es)
+            return nullptr;
+
+        uint k = 0;
+        bool hdone = false;
+        bool ldone = false;
+        while (k < count && !(hdone && ldone))
+        {
+            // cosh t and 2u = π sinh t, with e^t computed incrementally
+            y   = one / et;
+            ch  = (et + y) / two;
+            u2  = hpi * (et - y);
+            e2u = u2 ? exp::evaluate(u2) : nullptr;
+            if (!e2u)
+                return nullptr;
+
+            // Offset from the ends d * (1 - tanh u) and weight
+            y   = e2u + one;
+            off = two / y;
+            w   = hpi * ch * off * off * e2u;
+            off = dx * off;
+            if (!w || !off)
+                return nullptr;
+
+            // Contributions below that limit are negligible
+            limit = sum->is_zero() ? tiny : sum * tiny;
+            if (!limit)
+                return nullptr;
+
+            // Evaluate each end until the offset vanishes at the current
+            // precision or the contributions become negligible
+            if (!hdone)
+            {
+                x = hx - off;
+                y = x ? hx - x : nullptr;
+                if (!y)
+                    return nullptr;
+                hdone = y->is_zero();
+                if (!hdone)
+                {
+                    y = integrand(eq, x);
+                    y = y ? w * y : nullptr;
+                    sum = y ? sum + y : nullptr;
+                    if (!sum)
+                        return nullptr;
+                    hdone = smaller_magnitude(y, limit);
+                }
+            }
+            if (!ldone)
+            {
+                x = lx + off;
+                y = x ? x - lx : nullptr;
+                if (!y)
+                    return nullptr;
+                ldone = y->is_zero();
+                if (!ldone)
+                {
+                    y = integrand(eq, x);
+                    y = y ? w * y : nullptr;
+                    sum = y ? sum + y : nullptr;
+                    if (!sum)
+                        return nullptr;
+                    ldone = smaller_magnitude(y, limit);
+                }
+            }
+            if (!algebraic::to_decimal_if_big(sum))
+                return nullptr;
+            record(integrate, "[%u:%u] w=%t sum=%t", level, k, +w, +sum);
+
+            et = et * es;
+            if (!et || !algebraic::to_decimal_if_big(et))
+                return nullptr;
+            k++;
+        }
+
+        // Do not go further in later levels than at the first one
+        if (level == 0)
+            count = k;
+
+        // Estimate at this level, and check if we converged
+        est = sum * h * dx;
+        if (!est || !algebraic::to_decimal(est))
+            return nullptr;
+        if (level > 0)
+        {
+            y = est - last;
+            if (!est->is_zero())
+                y = y / est;
+            if (!y)
+                return nullptr;
+            if (smaller_magnitude(y, eps))
+                return est;
+        }
+        if (level == max)
+            return est;
+        last = est;
+
+        // Twice as many points in the next level
+        h = h / two;
+        if (!h)
+            return nullptr;
+        if (level > 0)
+            count += count;
+    }
+    return nullptr;
+}
@@ -37,7 +37,13 @@ algebraic_p integrate(program_g    eq,
                       symbol_g    name,
                       algebraic_g low,
                       algebraic_g high);
+algebraic_p romberg_integrate(program_r eq, algebraic_r low, algebraic_r high);
+algebraic_p tanh_sinh_integrate(program_r eq, algebraic_r low, algebraic_r high);
+
+// Number of evaluations of the integrand during the last integration
+extern uint integrate_evaluations;
 
 COMMAND_DECLARE(Integrate);
+COMMAND_DECLARE(IntegrationEvaluations);
 
 #endif // INTEGRATE_H
@@ -93,6 +93,20 @@ inline Data *leb128(Data *p, Int value)
 }
 
 
+constexpr byte *leb128_constexpr(byte *p, uint value)
+// ----------------------------------------------------------------------------
+//   Write an unsigned LEB value at compile time, for read-only object tables
+// ----------------------------------------------------------------------------
+{
+    do
+    {
+        *p++ = (value & 0x7F) | (value > 0x7F ? 0x80 : 0);
+        value >>= 7;
+    } while (value);
+    return p;
+}
+
+
 template<typename Int>
 inline size_t leb128size(Int value)
 // ----------------------------------------------------------------------------
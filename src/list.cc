@@ -39,6 +39,8 @@
 #include "program.h"
 #include "renderer.h"
 #include "runtime.h"
+#include "stack.h"
+#include "stats.h"
 #include "symbol.h"
 #include "utf8.h"
 #include "variables.h"
@@ -502,6 +504,198 @@ HELP_BODY(list)
 
 
 
+// ============================================================================
+//
+//   Element index
+//
+// ============================================================================
+//   Large lists and arrays get an index of the offsets of their elements,
+//   so that indexed accesses, e.g. GET or PUT in a loop, do not walk the
+//   list from the start each time. Like the directory name index, this is
+//   a side cache in the C heap, rebuilt lazily, forgotten whenever objects
+//   move or are modified, and released when the garbage collector runs or
+//   another side cache needs memory.
+
+struct list_index
+// ----------------------------------------------------------------------------
+//   A small number of indexed lists
+// ----------------------------------------------------------------------------
+{
+    enum
+    {
+        SLOTS       = 4,        // Number of lists we remember
+        MIN_SIZE    = 128,      // Below that many bytes, walk the list
+        MAX_OFFSET  = 0xFFFF,   // Offsets must fit in a uint16_t
+    };
+
+    struct slot
+    {
+        list_p    list;         // List being indexed
+        size_t    size;         // Size of the payload when indexed
+        uint16_t *offsets;      // Offset of each item in the payload
+        uint      count;        // Number of items, 0 = not indexed
+        uint      capacity;     // Number of offsets allocated
+    };
+
+    slot        slots[SLOTS];
+    uint        victim;
+
+    slot *      find(list_p list, size_t size);
+    void        build(slot *s, list_p list, size_t size);
+    void        forget(bool release);
+    static void purge();
+};
+
+static list_index ListIndex;
+static side_cache ListCache(list_index::purge);
+
+
+list_index::slot *list_index::find(list_p list, size_t size)
+// ----------------------------------------------------------------------------
+//   Find or build the index for the given list
+// ----------------------------------------------------------------------------
+{
+    for (uint i = 0; i < SLOTS; i++)
+        if (slots[i].list == list && slots[i].size == size)
+            return &slots[i];
+
+    slot *s = &slots[victim++ % SLOTS];
+    build(s, list, size);
+    return s;
+}
+
+
+void list_index::build(slot *s, list_p list, size_t size)
+// ----------------------------------------------------------------------------
+//   Build the offset index for a list
+// ----------------------------------------------------------------------------
+//   If the list is too large, or if we run out of memory, the slot simply
+//   records that the list is not indexed
+{
+    s->list  = list;
+    s->size  = size;
+    s->count = 0;
+    if (size > MAX_OFFSET)
+        return;
+
+    // Count items to size the table
+    byte_p first = byte_p(list->objects());
+    uint   count = 0;
+    for (size_t o = 0; o < size; o += object_p(first + o)->size())
+        count++;
+    if (count > s->capacity)
+    {
+        void *table = ListCache.resize(s->offsets,
+                                       s->capacity * sizeof(uint16_t),
+                                       count * sizeof(uint16_t));
+        if (!table)
+            return;
+        s->offsets = (uint16_t *) table;
+        s->capacity = count;
+    }
+
+    uint i = 0;
+    for (size_t o = 0; o < size; o += object_p(first + o)->size())
+        s->offsets[i++] = uint16_t(o);
+    s->count = count;
+    record(list, "Indexed list %p, %u items", list, count);
+}
+
+
+void list_index::forget(bool release)
+// ----------------------------------------------------------------------------
+//   Forget all indexes, and release their memory if requested
+// ----------------------------------------------------------------------------
+{
+    for (uint i = 0; i < SLOTS; i++)
+    {
+        slot *s = &slots[i];
+        s->list = nullptr;
+        s->count = 0;
+        if (release)
+        {
+            ListCache.release(s->offsets, s->capacity * sizeof(uint16_t));
+            s->offsets = nullptr;
+            s->capacity = 0;
+        }
+    }
+}
+
+
+void list_index::purge()
+// ----------------------------------------------------------------------------
+//   Release the memory of all indexes when another side cache needs it
+// ----------------------------------------------------------------------------
+{
+    ListIndex.forget(true);
+}
+
+
+void list::index_invalidate(bool release)
+// ----------------------------------------------------------------------------
+//   Invalidate the element indexes, e.g. when objects move
+// ----------------------------------------------------------------------------
+{
+    ListIndex.forget(release);
+}
+
+
+object_p list::at(size_t index) const
+// ----------------------------------------------------------------------------
+//   Return the n-th element in the list
+// ----------------------------------------------------------------------------
+{
+    size_t   size  = 0;
+    object_p first = objects(&size);
+    if (size >= list_index::MIN_SIZE && rt.is_allocated(this))
+    {
+        list_index::slot *s = ListIndex.find(this, size);
+        if (s->count)
+            return index < s->count ? first + s->offsets[index] : nullptr;
+    }
+    return *iterator(this, index);
+}
+
+
+static bool put_in_place(list_p items, object_p index, object_g value)
+// ----------------------------------------------------------------------------
+//   Replace an item in a global list in place if it has the same size
+// ----------------------------------------------------------------------------
+//   This avoids copying the whole list for each PUT on a named list.
+//   Since the list and the item are modified, stack references to either
+//   are cloned first, like when storing a value of the same size. This
+//   includes references inside the item, e.g. from GET on a nested list.
+{
+    if (!rt.is_global(items) || !index->is_integer())
+        return false;
+    size_t idx = index->as_uint32(0, false);
+    if (!idx)
+        return false;
+    object_p item = items->at(idx - 1);
+    if (!item)
+        return false;
+    size_t size = value->size();
+    if (item->size() != size)
+        return false;
+
+    // Make sure that cloning cannot fail, not to leave null on the stack
+    if (!rt.clone_global(item, size))
+        return false;
+    size_t needed = items->size();
+    if (rt.available(needed) < needed)
+        return false;
+    rt.clone_global(items);
+
+    // Global objects do not move during garbage collection
+    memmove((byte *) item, +value, size);
+    list::index_invalidate();
+    StatsData::sums_invalidate();
+    Stack.clear_cache();
+    return true;
+}
+
+
+
 // ============================================================================
 //
 //   Command implementation
@@ -698,6 +892,29 @@ static object::result put(bool increment)
                 return object::ERROR;
         }
 
+        // Replace same-size items in named lists without copying them
+        object::id ty = items->type();
+        if (name && (ty == object::ID_list || ty == object::ID_array))
+        {
+            if (put_in_place(list_p(items), rt.stack(1), rt.top()))
+            {
+                if (increment)
+                {
+                    // Global objects do not move during garbage collection
+                    object_g index = rt.stack(1);
+                    bool wrap = items->next_index(&+index);
+                    if (!index)
+                        return object::ERROR;
+                    rt.stack(1, +index);
+                    Settings.IndexWrapped(wrap);
+                }
+                rt.drop(increment ? 1 : 3);
+                return object::OK;
+            }
+            if (rt.error())
+                return object::ERROR;
+        }
+
         if (object_g result = items->at(rt.stack(1), rt.top()))
         {
             if (increment)
@@ -227,13 +227,15 @@ struct list : text
     }
 
 
-    object_p at(size_t index) const
+    object_p at(size_t index) const;
     // ------------------------------------------------------------------------
-    //   Return the n-th element in the list
+    //   Return the n-th element in the list, using an index for large lists
+    // ------------------------------------------------------------------------
+
+    static void index_invalidate(bool release = false);
+    // ------------------------------------------------------------------------
+    //   Forget the element indexes, e.g. when objects move
     // ------------------------------------------------------------------------
-    {
-        return *iterator(this, index);
-    }
 
 
     template<typename ...args>
@@ -556,8 +556,15 @@ static object::result counted_loop(object::id type, object_p o)
     object_g last  = rt.pop();
     object_g first = rt.pop();
 
+    // Small integer bounds are kept as raw native counters in the frame
+    intptr_t ifirst, ilast;
+    bool     native = runtime::small_counter(first, ifirst) &&
+                      runtime::small_counter(last, ilast);
+    bool     for_loop = type >= object::ID_for_next_conditional;
+    size_t   depth = 0;
+
     // Check if we need a local variable
-    if (type >= object::ID_for_next_conditional)
+    if (for_loop)
     {
         // For debugging or conversion to text, ensure we track names
         locals_stack stack(p);
@@ -569,10 +576,11 @@ static object::result counted_loop(object::id type, object_p o)
         size_t namesz = leb128<size_t>(p);
         p += namesz;
 
-        // Get start value as local
-        if (!rt.push(first))
+        // Get start value as local, only built when read if native
+        if (!rt.push(native ? runtime::counter_variable() : +first))
             return object::ERROR;
         rt.locals(1);
+        depth = rt.locals();
 
         // Pop local after execution
         if (!rt.run_push_data(nullptr, object_p(1)))
@@ -580,8 +588,21 @@ static object::result counted_loop(object::id type, object_p o)
     }
 
     object_g body = object_p(p);
-    if (body->defer() && rt.run_push_data(first, last) &&
-        object::defer(type) && body->defer())
+    if (!body->defer())
+        return object::ERROR;
+    if (native)
+    {
+        object_p mark = for_loop ? runtime::for_mark() : runtime::start_mark();
+        if ((for_loop && !rt.run_push_counter(mark, depth)) ||
+            !rt.run_push_counter(mark, ilast) ||
+            !rt.run_push_counter(mark, ifirst))
+            return object::ERROR;
+    }
+    else if (!rt.run_push_data(first, last))
+    {
+        return object::ERROR;
+    }
+    if (object::defer(type) && body->defer())
         return object::OK;
 
     return object::ERROR;
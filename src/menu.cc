@@ -707,7 +707,14 @@ MENU(PopulationMenu,
      "Bins",    ID_FrequencyBins,
      "PopVar",  ID_PopulationVariance,
      "PopSDev", ID_PopulationStandardDeviation,
-     "PCovar",  ID_PopulationCovariance);
+     "PCovar",  ID_PopulationCovariance,
+
+     "Median",  ID_Median,
+     "Quartl",  ID_Quartiles,
+     "Quantl",  ID_Quantile,
+     "Pctile",  ID_Percentile,
+     "Mean",    ID_Average,
+     "Var",     ID_Variance);
 
 
 MENU(SignalProcessingMenu,
@@ -1085,7 +1092,11 @@ MENU(IntegrationMenu,
      "Prim",    ID_Unimplemented,
 
      "Eq",      ID_Equation,
-     "Indep",   ID_Unimplemented);
+     "Indep",   ID_Unimplemented,
+
+     "Romberg", ID_RombergIntegration,
+     "TanhSinh",ID_TanhSinhIntegration,
+     "Evals",   ID_IntegrationEvaluations);
 
 MENU(DifferentiationMenu,
 // ----------------------------------------------------------------------------
@@ -1130,8 +1141,12 @@ MENU(NumericalSolverMenu,
 // ----------------------------------------------------------------------------
      "Eq",      ID_Equation,
      "Indep",   ID_Unimplemented,
-     "Root",    ID_Unimplemented,
+     "Root",    ID_Root,
+     "Secant",  ID_SecantSolver,
+     "Hybrid",  ID_HybridSolver,
 
+     "Iters",   ID_SolverIterationCount,
+     "Evals",   ID_SolverEvaluations,
      ID_SolverMenu);
 
 MENU(DifferentialSolverMenu,
@@ -1250,7 +1265,9 @@ MENU(PlotMenu,
      "No Axes", ID_NoPlotAxes,
 
      "Backgnd", ID_Background,
-     "Clear",   ID_ClLCD);
+     "Clear",   ID_ClLCD,
+     "Adaptive",ID_AdaptivePlotSampling,
+     "FullSmpl",ID_FullPlotSampling);
 
 MENU(ClearThingsMenu,
 // ----------------------------------------------------------------------------
@@ -1422,7 +1439,8 @@ MENU(FilesMenu,
      "Read",    ID_Unimplemented,
      "Write",   ID_Unimplemented,
      "Seek",    ID_Unimplemented,
-     "Dir",     ID_Unimplemented);
+     "Dir",     ID_Unimplemented,
+     "Calls",   ID_FileSystemCalls);
 
 MENU(GraphicsMenu,
 // ----------------------------------------------------------------------------
@@ -1464,7 +1482,10 @@ MENU(MemMenu,
      "Free",    ID_FreeMemory,
      "System",  ID_SystemMemory,
      "Recall",  ID_Rcl,
-     "PgAll",   ID_PurgeAll);
+     "PgAll",   ID_PurgeAll,
+
+     "Stats",   ID_MemoryStatistics,
+     "RstStat", ID_ResetMemoryStatistics);
 
 
 MENU(LibsMenu,
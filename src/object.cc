@@ -34,6 +34,7 @@
 #include "array.h"
 #include "bignum.h"
 #include "catalog.h"
+#include "command.h"
 #include "comment.h"
 #include "compare.h"
 #include "complex.h"
@@ -93,6 +94,9 @@ const object::spelling object::spellings[] =
 };
 
 const size_t object::spelling_count  = sizeof(spellings) / sizeof(*spellings);
+static_assert(sizeof(object::spellings) / sizeof(*object::spellings) ==
+              object::SPELLINGS,
+              "The spellings table does not match ids.tbl");
 
 
 utf8 object::alias(id t, uint index)
@@ -171,6 +175,67 @@ const object::dispatch object::handler[NUM_IDS] =
 };
 
 
+// ----------------------------------------------------------------------------
+//   Table of the types that have their own parser, in parsing order
+// ----------------------------------------------------------------------------
+//   Most types inherit the default parser, which always skips, and all
+//   commands are parsed in one go under `Drop`. The table is computed at
+//   compile time from ids.tbl, so that `parse()` only calls real parsers.
+//   Parse ID_symbol last, we need to check commands first.
+
+static constexpr bool has_parser[object::NUM_IDS] =
+{
+#define ID(id)          NAMED(id,#id)
+#define CMD(id)         ID(id)
+#define NAMED(id, label)                                                \
+    [object::ID_##id] = (&id::do_parse != &object::do_parse &&          \
+                         (&id::do_parse != &command::do_parse ||        \
+                          object::ID_##id == object::ID_Drop)),
+#include "ids.tbl"
+};
+
+
+static constexpr uint parser_count()
+// ----------------------------------------------------------------------------
+//   Count the types that have their own parser
+// ----------------------------------------------------------------------------
+{
+    uint count = 0;
+    for (uint i = 0; i < object::NUM_IDS; i++)
+        count += has_parser[i];
+    return count;
+}
+
+
+struct parser_table
+// ----------------------------------------------------------------------------
+//   The types to try, in the order we try them
+// ----------------------------------------------------------------------------
+{
+    uint16_t    ids[parser_count()];
+};
+
+
+static constexpr parser_table parser_build()
+// ----------------------------------------------------------------------------
+//   Build the table of parsers
+// ----------------------------------------------------------------------------
+{
+    parser_table table = {};
+    uint         count = 0;
+    for (uint i = 0; i < object::NUM_IDS; i++)
+    {
+        uint candidate = (i + object::ID_symbol + 1) % object::NUM_IDS;
+        if (has_parser[candidate])
+            table.ids[count++] = candidate;
+    }
+    return table;
+}
+
+static constexpr parser_table parsers = parser_build();
+static constexpr uint         parsers_count = parser_count();
+
+
 object_p object::parse(utf8 source, size_t &size, int precedence)
 // ----------------------------------------------------------------------------
 //  Try parsing the object as a top-level temporary
@@ -180,7 +245,7 @@ object_p object::parse(utf8 source, size_t &size, int precedence)
 //  + if precedence < 0, then we are parsing an infix at that precedence
 {
     record(parse, ">Parsing [%s] precedence %d, %u IDs to try",
-           source, precedence, NUM_IDS);
+           source, precedence, parsers_count);
 
     // Skip spaces and newlines
     size_t skipped = utf8_skip_whitespace(source);
@@ -198,12 +263,12 @@ object_p object::parse(utf8 source, size_t &size, int precedence)
     do
     {
         r = SKIP;
-        for (uint i = 0; r == SKIP && i < NUM_IDS; i++)
+        for (uint i = 0; r == SKIP && i < parsers_count; i++)
         {
-            // Parse ID_symbol last, we need to check commands first
-            uint candidate = (i + ID_symbol + 1) % NUM_IDS;
+            uint candidate = parsers.ids[i];
             p.candidate = id(candidate);
-            record(parse_attempts, "Trying [%s] against %+s", src, name(id(i)));
+            record(parse_attempts, "Trying [%s] against %+s",
+                   src, name(id(candidate)));
             r = handler[candidate].parse(p);
             if (r == COMMENTED)
             {
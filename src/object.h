@@ -215,6 +215,18 @@ struct object
     static const spelling spellings[];
     static const size_t   spelling_count;
 
+    enum spelling_size : size_t
+    // ------------------------------------------------------------------------
+    //   Number of spellings, checked against tables built from ids.tbl
+    // ------------------------------------------------------------------------
+    {
+        SPELLINGS = 0
+#define ALIAS(ty, name)         + 1
+#define ID(ty)                  ALIAS(ty, #ty)
+#define NAMED(ty, name)         ALIAS(ty, name) ALIAS(ty, #ty)
+#include "ids.tbl"
+    };
+
 
 
     // ========================================================================
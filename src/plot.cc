@@ -40,6 +40,8 @@
 #include "target.h"
 #include "variables.h"
 
+#include <cstring>
+
 
 void draw_axes(const PlotParametersAccess &ppar)
 // ----------------------------------------------------------------------------
@@ -126,6 +128,345 @@ uint draw_data(array::iterator &it, array::iterator &end,
 }
 
 
+static void plot_error()
+// ----------------------------------------------------------------------------
+//   Show an evaluation error at the top of the plot
+// ----------------------------------------------------------------------------
+{
+    if (!rt.error())
+        rt.invalid_function_error();
+    Screen.text(0, 0, rt.error(), ErrorFont,
+                pattern::white, pattern::black);
+    ui.draw_dirty(0, 0, LCD_W, ErrorFont->height());
+    refresh_dirty();
+    ui.draw_clean();
+    rt.clear_error();
+}
+
+
+
+// ============================================================================
+//
+//   Function plot cache and adaptive sampling
+//
+// ============================================================================
+//
+//   Function plots remember the pixel row computed for each column, so that
+//   redrawing the same plot, e.g. after drawing axes or changing the line
+//   width, does not evaluate the function again. The cache is keyed on a hash
+//   of everything that can change the rows: the equation, the variables in
+//   the current path, the settings, and plot parameters other than the
+//   horizontal position. Panning horizontally by a whole number of pixels
+//   shifts the cached rows instead of discarding them.
+//
+//   When the AdaptivePlotSampling flag is set, the function is first sampled
+//   every COARSE columns, and each interval is only subdivided where the
+//   curve bends or jumps, i.e. when the middle sample is more than one pixel
+//   away from the chord, or when the ends are far apart vertically.
+
+struct plot_cache
+// ----------------------------------------------------------------------------
+//   Pixel rows for each column of the last function plot
+// ----------------------------------------------------------------------------
+{
+    enum : int16_t
+    {
+        UNKNOWN = INT16_MIN,            // Column not evaluated yet
+        INVALID,                        // Evaluation failed at this column
+        LOWEST                          // Lowest valid row
+    };
+    enum { COLUMNS = LCD_W + 1, COARSE = 8 };
+
+    plot_cache(): key(), xmin(), rows() {}
+
+    void clear()
+    {
+        for (uint c = 0; c < COLUMNS; c++)
+            rows[c] = UNKNOWN;
+    }
+    void select(uint32_t key, algebraic_r xmin, algebraic_r range, uint width);
+
+    uint32_t    key;
+    algebraic_g xmin;
+    int16_t     rows[COLUMNS];
+};
+
+static plot_cache PlotCache;
+
+
+void plot_cache::select(uint32_t k, algebraic_r x, algebraic_r range, uint w)
+// ----------------------------------------------------------------------------
+//   Select the cache for a plot, shifting it if the plot was panned
+// ----------------------------------------------------------------------------
+{
+    if (k == key && xmin && x)
+    {
+        size_t sz = x->size();
+        if (xmin->size() == sz && memcmp(+x, +xmin, sz) == 0)
+            return;
+
+        algebraic_g shift = (x - xmin) / range * integer::make(w);
+        if (shift)
+        {
+            int         cols  = shift->as_int32(0, false);
+            algebraic_g exact = integer::make(cols);
+            exact = exact == shift;
+            if (exact && exact->as_truth(false) && uint(abs(cols)) <= w)
+            {
+                uint keep = w + 1 - abs(cols);
+                if (cols > 0)
+                {
+                    memmove(rows, rows + cols, keep * sizeof(rows[0]));
+                    for (uint c = keep; c <= w; c++)
+                        rows[c] = UNKNOWN;
+                }
+                else
+                {
+                    memmove(rows - cols, rows, keep * sizeof(rows[0]));
+                    for (uint c = 0; c < uint(-cols); c++)
+                        rows[c] = UNKNOWN;
+                }
+                xmin = x;
+                return;
+            }
+        }
+        rt.clear_error();
+    }
+    clear();
+    key  = k;
+    xmin = x;
+}
+
+
+static uint32_t plot_hash(uint32_t hash, const void *data, size_t len)
+// ----------------------------------------------------------------------------
+//   FNV-1a hash of the given bytes
+// ----------------------------------------------------------------------------
+{
+    byte_p p = byte_p(data);
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ p[i]) * 16777619u;
+    return hash;
+}
+
+
+static uint32_t plot_hash(uint32_t hash, object_p obj)
+// ----------------------------------------------------------------------------
+//   Hash the bytes of an object
+// ----------------------------------------------------------------------------
+{
+    return obj ? plot_hash(hash, obj, obj->size()) : hash;
+}
+
+
+static bool plot_hash_variable(object_p name, object_p value, void *arg)
+// ----------------------------------------------------------------------------
+//   Hash a variable that may be used while evaluating the function
+// ----------------------------------------------------------------------------
+//   Plot parameters are hashed separately, and only directories in the
+//   current path are visible to the function
+{
+    if (name->type() == object::ID_PlotParameters ||
+        value->type() == object::ID_directory)
+        return false;
+    uint32_t &hash = *((uint32_t *) arg);
+    hash = plot_hash(plot_hash(hash, name), value);
+    return true;
+}
+
+
+static uint32_t plot_key(const PlotParametersAccess &ppar, program_r eq,
+                         algebraic_r range, uint width, uint height)
+// ----------------------------------------------------------------------------
+//   Compute the cache key for a function plot
+// ----------------------------------------------------------------------------
+{
+    // Settings that only change how the curve is drawn do not matter
+    settings defaults;
+    settings s = Settings;
+    s.NoPlotAxes(defaults.NoPlotAxes());
+    s.NoCurveFilling(defaults.NoCurveFilling());
+    s.AdaptivePlotSampling(defaults.AdaptivePlotSampling());
+    s.LineWidth(defaults.LineWidth());
+    s.Foreground(defaults.Foreground());
+
+    uint32_t hash = plot_hash(2166136261u, &s, sizeof(s));
+    hash = plot_hash(hash, &width, sizeof(width));
+    hash = plot_hash(hash, &height, sizeof(height));
+    hash = plot_hash(hash, +eq);
+    hash = plot_hash(hash, +ppar.independent);
+    hash = plot_hash(hash, +ppar.ymin);
+    hash = plot_hash(hash, +ppar.ymax);
+    hash = plot_hash(hash, +range);
+    for (uint depth = 0; directory *dir = rt.variables(depth); depth++)
+        dir->enumerate(plot_hash_variable, &hash);
+    return hash;
+}
+
+
+struct plot_sampler
+// ----------------------------------------------------------------------------
+//   Evaluate and draw a function plot column by column
+// ----------------------------------------------------------------------------
+{
+    plot_sampler(const PlotParametersAccess &ppar, program_r eq,
+                 algebraic_r step, uint width)
+        : ppar(ppar), eq(eq), step(step), width(width),
+          jump(ScreenHeight() / 4), drawn(0), lx(-1), ly(-1),
+          lw(Settings.LineWidth()), fg(Settings.Foreground()),
+          split_points(Settings.NoCurveFilling())
+    {}
+
+    int  row(uint column);
+    bool refine(uint left, uint right);
+    void draw(uint upto);
+
+    const PlotParametersAccess &ppar;
+    program_r                   eq;
+    algebraic_r                 step;
+    uint                        width;
+    int                         jump;
+    uint                        drawn;
+    coord                       lx, ly;
+    size                        lw;
+    pattern                     fg;
+    bool                        split_points;
+};
+
+
+int plot_sampler::row(uint column)
+// ----------------------------------------------------------------------------
+//   Return the pixel row for a column, evaluating the function if needed
+// ----------------------------------------------------------------------------
+{
+    int16_t cached = PlotCache.rows[column];
+    if (cached != plot_cache::UNKNOWN)
+        return cached;
+
+    algebraic_g x = integer::make(column);
+    x = ppar.xmin + step * x;
+    algebraic_g y = x ? algebraic::evaluate_function(eq, x) : nullptr;
+    if (!y)
+    {
+        // Do not remember failures caused by interrupting the plot
+        bool interrupted = program::interrupted();
+        plot_error();
+        if (!interrupted)
+            PlotCache.rows[column] = plot_cache::INVALID;
+        return plot_cache::INVALID;
+    }
+
+    int ry = ppar.pixel_y(y);
+    if (ry < plot_cache::LOWEST)
+        ry = plot_cache::LOWEST;
+    else if (ry > INT16_MAX)
+        ry = INT16_MAX;
+    PlotCache.rows[column] = ry;
+    return ry;
+}
+
+
+bool plot_sampler::refine(uint left, uint right)
+// ----------------------------------------------------------------------------
+//   Evaluate the ends of an interval, and subdivide it where necessary
+// ----------------------------------------------------------------------------
+{
+    int yl = row(left);
+    int yr = row(right);
+    if (program::interrupted())
+        return false;
+    if (right - left < 2)
+        return true;
+
+    uint mid   = (left + right) / 2;
+    int  ym    = row(mid);
+    bool split = (yl == plot_cache::INVALID ||
+                  yr == plot_cache::INVALID ||
+                  ym == plot_cache::INVALID);
+    if (!split)
+    {
+        int chord = yl + (yr - yl) * int(mid - left) / int(right - left);
+        split = abs(ym - chord) > 1 || abs(yr - yl) > jump;
+    }
+    if (split)
+        return refine(left, mid) && refine(mid, right);
+    return true;
+}
+
+
+void plot_sampler::draw(uint upto)
+// ----------------------------------------------------------------------------
+//   Draw the curve up to the given column using the rows computed so far
+// ----------------------------------------------------------------------------
+{
+    for (; drawn <= upto; drawn++)
+    {
+        int ry = PlotCache.rows[drawn];
+        if (ry == plot_cache::UNKNOWN)
+            continue;
+        if (ry == plot_cache::INVALID)
+        {
+            lx = ly = -1;
+            continue;
+        }
+
+        coord rx = drawn;
+        if (lx < 0 || split_points)
+        {
+            lx = rx;
+            ly = ry;
+        }
+        Screen.line(lx, ly, rx, ry, lw, fg);
+        ui.draw_dirty(lx, ly, rx, ry);
+        lx = rx;
+        ly = ry;
+    }
+}
+
+
+static object::result draw_function(const PlotParametersAccess &ppar,
+                                    program_r                   eq)
+// ----------------------------------------------------------------------------
+//   Draw a function plot, one sample per column, using the plot cache
+// ----------------------------------------------------------------------------
+{
+    uint width = ScreenWidth();
+    if (width >= plot_cache::COLUMNS)
+        width = plot_cache::COLUMNS - 1;
+
+    algebraic_g range = ppar.xmax - ppar.xmin;
+    algebraic_g step  = range / integer::make(width);
+    if (!step)
+        return object::ERROR;
+    uint32_t key = plot_key(ppar, eq, range, width, ScreenHeight());
+    PlotCache.select(key, ppar.xmin, range, width);
+
+    plot_sampler sampler(ppar, eq, step, width);
+    uint         coarse = 1;
+    if (Settings.AdaptivePlotSampling() && !Settings.NoCurveFilling())
+        coarse = plot_cache::COARSE;
+
+    uint then = sys_current_ms();
+    for (uint left = 0; left < width; left += coarse)
+    {
+        uint right = left + coarse < width ? left + coarse : width;
+        if (!sampler.refine(left, right))
+            break;
+        sampler.draw(right);
+
+        uint now = sys_current_ms();
+        if (now - then > 500)
+        {
+            then = now;
+            refresh_dirty();
+            ui.draw_clean();
+        }
+    }
+    refresh_dirty();
+    return object::OK;
+}
+
+
 
 object::result draw_plot(object::id                  kind,
                          const PlotParametersAccess &ppar,
@@ -237,6 +578,15 @@ object::result draw_plot(object::id                  kind,
     size    lw           = Settings.LineWidth();
     pattern fg           = Settings.Foreground();
 
+    // A few digits are enough to compute pixels, evaluate at lower precision
+    uint digits = Settings.PlotPrecision();
+    if (!digits || digits > Settings.Precision())
+        digits = Settings.Precision();
+    settings::SavePrecision saved_precision(digits);
+
+    if (kind == object::ID_Function && eq && ppar.resolution->is_zero())
+        return draw_function(ppar, eq);
+
     while (!program::interrupted())
     {
         coord rx     = 0;
@@ -323,15 +673,8 @@ object::result draw_plot(object::id                  kind,
         }
         else
         {
-            if (!rt.error())
-                rt.invalid_function_error();
-            Screen.text(0, 0, rt.error(), ErrorFont,
-                        pattern::white, pattern::black);
-            ui.draw_dirty(0, 0, LCD_W, ErrorFont->height());
-            refresh_dirty();
-            ui.draw_clean();
+            plot_error();
             lx = ly = -1;
-            rt.clear_error();
         }
 
         if (kind != object::ID_Scatter)
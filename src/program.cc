@@ -168,7 +168,16 @@ object::result program::run_loop(size_t depth)
         {
             if (last_args)
                 rt.need_save();
+
+            // Attribute allocations to the command (obj may move in a GC)
+            const runtime::statistics &stats = rt.stats();
+            size_t allocated   = stats.allocated;
+            uint   collections = stats.collections;
+            id     type        = obj->type();
             result = obj->evaluate();
+            if (stats.allocated != allocated ||
+                stats.collections != collections)
+                rt.attribute(type, allocated, collections);
         }
 
         if (stepping)
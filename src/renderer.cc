@@ -36,6 +36,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wctype.h>
 
 renderer::~renderer()
@@ -64,10 +65,18 @@ bool renderer::put(cstring s)
 //   Put a null-terminated string
 // ----------------------------------------------------------------------------
 {
-    for (char c = *s++; c; c = *s++)
-        if (!put(c))
-            return false;
-    return true;
+    return put(s, strlen(s));
+}
+
+
+static inline bool ordinary(byte c)
+// ----------------------------------------------------------------------------
+//   Check if a character needs no special processing while rendering
+// ----------------------------------------------------------------------------
+//   Spaces, line breaks and tabs interact with indentation and the flat
+//   stack format, and quotes toggle text mode. Everything else is copied.
+{
+    return c > ' ' && c != '"';
 }
 
 
@@ -75,14 +84,80 @@ bool renderer::put(cstring s, size_t len)
 // ----------------------------------------------------------------------------
 //   Put a length-based string
 // ----------------------------------------------------------------------------
+//   Runs of ordinary characters are copied in one go, other characters
+//   go through put(char) to deal with whitespace and text mode.
 {
-    for (size_t i = 0; i < len; i++)
-        if (!put(s[i]))
+    gcutf8 src = (byte *) s;
+    size_t i   = 0;
+    while (i < len)
+    {
+        utf8   p   = +src + i;
+        size_t run = 0;
+        while (i + run < len && ordinary(p[run]))
+            run++;
+        if (run)
+        {
+            if (!put_run(+src + i, run))
+                return false;
+            i += run;
+        }
+        else if (!put(char(p[0])))
+        {
             return false;
+        }
+        else
+        {
+            i++;
+        }
+    }
     return true;
 }
 
 
+bool renderer::put_run(gcutf8 s, size_t run)
+// ----------------------------------------------------------------------------
+//   Write a run of ordinary characters with a single allocation
+// ----------------------------------------------------------------------------
+//   This is equivalent to calling put(char) for each character, but
+//   reserves the scratchpad space once and copies the run with memcpy.
+//   If the run does not fit, write what fits and return false.
+{
+    if (written >= length)
+        return false;
+
+    if (nl)
+    {
+        nl = false;
+        if (!put('\n'))
+            return false;
+    }
+
+    bool   fits = run <= length - written;
+    if (!fits)
+        run = length - written;
+
+    if (saving)
+    {
+        if (!saving->write(cstring(+s), run))
+            return false;
+    }
+    else if (target)
+    {
+        memcpy(target + written, +s, run);
+    }
+    else
+    {
+        if (!rt.append(run, s))
+            return false;
+    }
+    written += run;
+    cr = false;
+    if (stk && !mlstk)
+        space = false;
+    return fits;
+}
+
+
 bool renderer::put(char c)
 // ----------------------------------------------------------------------------
 //   Write a single character
@@ -217,10 +292,14 @@ bool renderer::put(object::id format, utf8 text, size_t len)
     default:
     case object::ID_LongFormNames:
     case object::ID_LongForm:
-        for (cstring p = cstring(text); size_t(utf8(p) - text) < len && *p; p++)
-            result = put(*p);
+    {
+        size_t sz = 0;
+        while (sz < len && text[sz])
+            sz++;
+        result = put(text, sz);
         break;
     }
+    }
 
     return result;
 }
@@ -119,6 +119,9 @@ struct renderer
             unwrite(written - sz);
     }
 
+protected:
+    bool   put_run(gcutf8 s, size_t run);
+
 protected:
     char        *target;        // Buffer where we render the object, or nullptr
     size_t      length;         // Available space
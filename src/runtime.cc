@@ -34,15 +34,19 @@
 #include "integer.h"
 #include "object.h"
 #include "program.h"
+#include "stack.h"
+#include "stats.h"
 #include "user_interface.h"
 #include "variables.h"
 
+#include <cstdlib>
 #include <cstring>
 
 
 // The one and only runtime
 runtime rt(nullptr, 0);
 runtime::gcptr *runtime::GCSafe = nullptr;
+byte            runtime::CounterMarks[2];
 
 RECORDER(runtime,       16, "RPL runtime");
 RECORDER(runtime_error, 16, "RPL runtime error (anomalous behaviors)");
@@ -81,7 +85,9 @@ runtime::runtime(byte *mem, size_t size)
       CallStack(),
       Returns(),
       HighMem(),
-      SaveArgs(false)
+      SaveArgs(false),
+      Stats(),
+      Attributions()
 {
     if (mem)
         memory(mem, size);
@@ -113,6 +119,11 @@ void runtime::memory(byte *memory, size_t size)
     Temporaries = Globals;                      // Area for temporaries
     Editing = 0;                                // No editor
     Scratch = 0;                                // No scratchpad
+    directory::index_invalidate();              // Forget name indexes
+    list::index_invalidate();                   // Forget element indexes
+    StatsData::sums_invalidate();               // Forget statistics sums
+    ::Stack.clear_cache();                      // Forget rendered objects
+    user_interface::editor_reset();             // Forget editor lines
 
     record(runtime, "Memory %p-%p size %u (%uK)",
            LowMem, HighMem, size, size>>10);
@@ -128,6 +139,24 @@ void runtime::reset()
 }
 
 
+byte *runtime::replace_globals(size_t size)
+// ----------------------------------------------------------------------------
+//   Reset the runtime and reserve room for a home directory image
+// ----------------------------------------------------------------------------
+//   This is used to restore binary state snapshots with a single read.
+//   The caller must write a valid directory of the given size at the
+//   returned address, or call reset() again.
+{
+    reset();
+    size_t home = (byte_p) Globals - (byte_p) LowMem;
+    if (size > home + available())
+        return nullptr;
+    Globals = (object_p) ((byte_p) LowMem + size);
+    Temporaries = Globals;
+    return (byte *) LowMem;
+}
+
+
 
 
 // ============================================================================
@@ -300,15 +329,93 @@ runtime::gcptr::~gcptr()
 }
 
 
+static int gc_compare_roots(const void *left, const void *right)
+// ----------------------------------------------------------------------------
+//   Compare two roots for sorting
+// ----------------------------------------------------------------------------
+{
+    object_p l = *((object_p *) left);
+    object_p r = *((object_p *) right);
+    return l < r ? -1 : l > r ? 1 : 0;
+}
+
+
+static inline bool gc_root(object_p  *roots,
+                           size_t    &count,
+                           size_t     max,
+                           object_p   first,
+                           object_p   last,
+                           const void *ptr)
+// ----------------------------------------------------------------------------
+//   Record a root if it points within the temporaries being collected
+// ----------------------------------------------------------------------------
+{
+    object_p obj = object_p(ptr);
+    if (obj >= first && obj < last)
+    {
+        if (count >= max)
+            return false;
+        roots[count++] = obj;
+    }
+    return true;
+}
+
+
+size_t runtime::gc_roots(object_p first, object_p last,
+                         object_p *roots, size_t max)
+// ----------------------------------------------------------------------------
+//   Collect all pointers to temporaries in a sorted array
+// ----------------------------------------------------------------------------
+//   Returns the number of roots, or ~0 if there is not enough room for them.
+//   GC-safe pointers are allowed to point to the end of an object, so they
+//   are recorded twice, once as is and once one byte lower.
+{
+    size_t count = 0;
+
+    for (object_p *s = Stack; s < HighMem; s++)
+    {
+        if (s >= Returns && counter_mark(*s))
+            s++;                // Skip raw loop counter
+        else if (!gc_root(roots, count, max, first, last, *s))
+            return ~size_t(0);
+    }
+
+    for (gcptr *p = GCSafe; p; p = p->next)
+        if (!gc_root(roots, count, max, first, last, p->safe) ||
+            !gc_root(roots, count, max, first, last, p->safe - 1))
+            return ~size_t(0);
+
+    if (!gc_root(roots, count, max, first, last, Error)         ||
+        !gc_root(roots, count, max, first, last, ErrorSave)     ||
+        !gc_root(roots, count, max, first, last, ErrorSource)   ||
+        !gc_root(roots, count, max, first, last, ErrorCommand)  ||
+        !gc_root(roots, count, max, first, last, ui.command))
+        return ~size_t(0);
+
+    utf8 *label = (utf8 *) &ui.menu_label[0][0];
+    for (uint l = 0; l < ui.NUM_MENUS; l++)
+        if (!gc_root(roots, count, max, first, last, label[l]))
+            return ~size_t(0);
+
+    qsort(roots, count, sizeof(*roots), gc_compare_roots);
+    return count;
+}
+
+
 size_t runtime::gc()
 // ----------------------------------------------------------------------------
 //   Recycle unused temporaries
 // ----------------------------------------------------------------------------
 //   Temporaries can only be referenced from the stack
 //   Objects in the global area are copied there, so they need no recycling
-//   This algorithm is linear in number of objects and moves only live data
+//   This algorithm moves only live data. The roots are sorted once in the
+//   free area above the scratchpad, so that the sweep is a single merge pass.
+//   If there is not enough free space for that, we fall back to rescanning
+//   all the roots for each object.
 {
     size_t   recycled = 0;
+    size_t   moved    = 0;
+    uint     start    = sys_current_ms();
     object_p first    = (object_p) Globals;
     object_p last     = Temporaries;
     object_p free     = first;
@@ -316,6 +423,11 @@ size_t runtime::gc()
 
     ui.draw_busy(L'●');
 
+    // Temporary directories may move, and we are short on memory
+    directory::index_invalidate(true);
+    list::index_invalidate(true);
+    ::Stack.clear_cache();
+
     record(gc, "Garbage collection, available %u, range %p-%p",
            available(), first, last);
 #ifdef SIMULATOR
@@ -333,6 +445,18 @@ size_t runtime::gc()
                          first, last, Stack, CallStack);
 #endif // SIMULATOR
 
+    // Mark phase: collect sorted roots in the free area if there is room
+    uintptr_t rstart = uintptr_t(scratchpad());
+    rstart = (rstart + sizeof(object_p) - 1) & ~(sizeof(object_p) - 1);
+    object_p *roots  = (object_p *) rstart;
+    object_p *rlimit = Stack - redzone / sizeof(object_p);
+    size_t    rmax   = roots < rlimit ? rlimit - roots : 0;
+    size_t    rcount = gc_roots(first, last, roots, rmax);
+    bool      sorted = rcount <= rmax;
+    object_p *root   = roots;
+    object_p *rend   = roots + (sorted ? rcount : 0);
+    record(gc, "Sorted %u roots (%+s)", rcount, sorted ? "merged" : "rescan");
+
     object_p *firstobjptr = Stack;
     object_p *lastobjptr = HighMem;
 
@@ -341,38 +465,56 @@ size_t runtime::gc()
         bool found = false;
         next = obj->skip();
         record(gc_details, "Scanning object %p (ends at %p)", obj, next);
-        for (object_p *s = firstobjptr; s < lastobjptr && !found; s++)
+        if (sorted)
         {
-            found = *s >= obj && *s < next;
+            // Sweep phase: consume the sorted roots that fall in this object
+            found = root < rend && *root < next;
+            while (root < rend && *root < next)
+                root++;
             if (found)
-                record(gc_details, "Found %p at stack level %u",
-                       obj, s - firstobjptr);
+                record(gc_details, "Found %p in sorted roots", obj);
         }
-        if (!found)
+        else
         {
-            for (gcptr *p = GCSafe; p && !found; p = p->next)
+            for (object_p *s = firstobjptr; s < lastobjptr && !found; s++)
             {
-                found = p->safe >= (byte *) obj && p->safe <= (byte *) next;
+                if (s >= Returns && counter_mark(*s))
+                {
+                    s++;        // Skip raw loop counter
+                    continue;
+                }
+                found = *s >= obj && *s < next;
                 if (found)
-                    record(gc_details, "Found %p in GC-safe pointer %p (%p)",
-                           obj, p->safe, p);
+                    record(gc_details, "Found %p at stack level %u",
+                           obj, s - firstobjptr);
             }
-        }
-        if (!found)
-        {
-            // Check if some of the error information was user-supplied
-            utf8 start = utf8(obj);
-            utf8 end = utf8(next);
-            found = (Error         >= start && Error         < end)
-                ||  (ErrorSave     >= start && ErrorSave     < end)
-                ||  (ErrorSource   >= start && ErrorSource   < end)
-                ||  (ErrorCommand  >= obj   && ErrorCommand  < next)
-                ||  (ui.command    >= start && ui.command    < end);
             if (!found)
             {
-                utf8 *label = (utf8 *) &ui.menu_label[0][0];
-                for (uint l = 0; !found && l < ui.NUM_MENUS; l++)
-                    found = label[l] >= start && label[l] < end;
+                for (gcptr *p = GCSafe; p && !found; p = p->next)
+                {
+                    found = p->safe >= (byte *) obj && p->safe <= (byte *) next;
+                    if (found)
+                        record(gc_details,
+                               "Found %p in GC-safe pointer %p (%p)",
+                               obj, p->safe, p);
+                }
+            }
+            if (!found)
+            {
+                // Check if some of the error information was user-supplied
+                utf8 start = utf8(obj);
+                utf8 end = utf8(next);
+                found = (Error         >= start && Error         < end)
+                    ||  (ErrorSave     >= start && ErrorSave     < end)
+                    ||  (ErrorSource   >= start && ErrorSource   < end)
+                    ||  (ErrorCommand  >= obj   && ErrorCommand  < next)
+                    ||  (ui.command    >= start && ui.command    < end);
+                if (!found)
+                {
+                    utf8 *label = (utf8 *) &ui.menu_label[0][0];
+                    for (uint l = 0; !found && l < ui.NUM_MENUS; l++)
+                        found = label[l] >= start && label[l] < end;
+                }
             }
         }
 
@@ -380,7 +522,11 @@ size_t runtime::gc()
         {
             // Move object to free space
             record(gc_details, "Moving %p-%p to %p", obj, next, free);
-            move(free, obj, next - obj);
+            if (free != obj)
+            {
+                move(free, obj, next - obj);
+                moved += next - obj;
+            }
             free += next - obj;
         }
         else
@@ -396,10 +542,15 @@ size_t runtime::gc()
     {
         object_p edit = Temporaries;
         move(edit - recycled, edit, Editing + Scratch, 1, true);
+        moved += Editing + Scratch;
     }
 
     // Adjust Temporaries
     Temporaries -= recycled;
+    Stats.recycled += recycled;
+    Stats.moved += moved;
+    Stats.collections++;
+    Stats.gc_time += sys_current_ms() - start;
 
 
 #ifdef SIMULATOR
@@ -473,7 +624,9 @@ void runtime::move(object_p to, object_p from,
     object_p *lastobjptr = HighMem;
     for (object_p *s = firstobjptr; s < lastobjptr; s++)
     {
-        if (*s >= from && *s < last)
+        if (s >= Returns && counter_mark(*s))
+            s++;                // Skip raw loop counter
+        else if (*s >= from && *s < last)
         {
             record(gc_details, "Adjusting stack level %u from %p to %p",
                    s - firstobjptr, *s, *s + delta);
@@ -520,6 +673,11 @@ void runtime::move_globals(object_p to, object_p from)
     if (Globals >= first && Globals < last)             // Storing global var
         Globals += delta;
     Temporaries += delta;
+
+    // Directory contents changed, name and element indexes are stale
+    directory::index_invalidate();
+    list::index_invalidate();
+    StatsData::sums_moved(to, from, last);
 }
 
 #ifdef DM42
@@ -552,6 +710,7 @@ size_t runtime::insert(size_t offset, utf8 data, size_t len)
             move(object_p(edr + len), object_p(edr), moved);
             memcpy(editor() + offset, data, len);
             Editing += len;
+            user_interface::editor_inserted(offset, len);
             return len;
         }
     }
@@ -581,6 +740,7 @@ size_t runtime::remove(size_t offset, size_t len)
     byte_p edr = (byte_p) editor() + offset;
     move(object_p(edr), object_p(edr + len), moving);
     Editing -= len;
+    user_interface::editor_removed(offset, len);
     return len;
 }
 
@@ -619,6 +779,7 @@ text_p runtime::close_editor(bool convert, bool trailing_zero)
 
     // We are no longer editing
     Editing = 0;
+    user_interface::editor_reset();
 
     // Import special characters if necessary (importing text file)
     if (convert)
@@ -650,6 +811,7 @@ size_t runtime::edit(utf8 buf, size_t len)
 
     memcpy((byte *) Temporaries, (byte *) buffer, len);
     Editing = len;
+    user_interface::editor_reset();
     return len;
 }
 
@@ -662,6 +824,7 @@ size_t runtime::edit()
     record(editor, "Editing scratch pad size %u, editor was %u",
            Scratch, Editing);
     Editing += Scratch;
+    user_interface::editor_inserted(Editing - Scratch, Scratch);
     Scratch = 0;
 
     record(editor, "Editor size now %u", Editing);
@@ -678,6 +841,7 @@ byte *runtime::allocate(size_t sz)
     {
         byte *scratch = editor() + Editing + Scratch;
         Scratch += sz;
+        Stats.allocated += sz;
         return scratch;
     }
 
@@ -698,6 +862,52 @@ byte *runtime::append(size_t sz, gcbytes bytes)
 }
 
 
+void runtime::attribute(uint type, size_t allocated, uint collections)
+// ----------------------------------------------------------------------------
+//   Charge allocations since the given counters to a command type
+// ----------------------------------------------------------------------------
+//   The table keeps the commands that allocated the most. A new command
+//   replaces the lightest entry, so steady churn surfaces over time.
+{
+    // Counters may have been reset while evaluating the command
+    if (Stats.allocated < allocated || Stats.collections < collections)
+        return;
+    size_t bytes = Stats.allocated - allocated;
+    uint   gcs   = Stats.collections - collections;
+    if (!bytes && !gcs)
+        return;
+
+    attribution *victim = Attributions;
+    for (attribution &a : Attributions)
+    {
+        if (a.calls && a.type == type)
+        {
+            a.calls++;
+            a.allocated += bytes;
+            a.collections += gcs;
+            return;
+        }
+        if (a.allocated < victim->allocated)
+            victim = &a;
+    }
+    victim->type = type;
+    victim->calls = 1;
+    victim->allocated = bytes;
+    victim->collections = gcs;
+}
+
+
+void runtime::reset_stats()
+// ----------------------------------------------------------------------------
+//   Reset memory management counters and per-command attribution
+// ----------------------------------------------------------------------------
+{
+    Stats = statistics();
+    for (attribution &a : Attributions)
+        a = attribution();
+}
+
+
 object_p runtime::clone(object_p source)
 // ----------------------------------------------------------------------------
 //   Clone an object into the temporaries area
@@ -709,6 +919,7 @@ object_p runtime::clone(object_p source)
         return nullptr;
     object_p result = Temporaries;
     Temporaries = object_p((byte *) Temporaries + size);
+    Stats.allocated += size;
     move(Temporaries, result, Editing + Scratch, 1, true);
     memmove((void *) result, source, size);
     return result;
@@ -736,6 +947,40 @@ object_p runtime::clone_global(object_p global)
 }
 
 
+bool runtime::clone_global(object_p global, size_t size)
+// ----------------------------------------------------------------------------
+//   Clone entries in the stack that point anywhere inside a global
+// ----------------------------------------------------------------------------
+//   This catches interior references, e.g. an element of a nested list
+//   returned by GET. If there is not enough memory to clone them all,
+//   return false without changing the stack.
+{
+    object_p  last   = global + size;
+    object_p *begin  = Stack;
+    object_p *end    = CallStack;
+    size_t    needed = 0;
+    for (object_p *s = begin; s < end; s++)
+        if (*s >= global && *s < last)
+            needed += (*s)->size();
+    if (!needed)
+        return true;
+    if (available(needed) < needed)
+        return false;
+
+    for (object_p *s = begin; s < end; s++)
+    {
+        if (*s >= global && *s < last)
+        {
+            object_p cloned = clone(*s);
+            if (!cloned)
+                return false;
+            *s = cloned;
+        }
+    }
+    return true;
+}
+
+
 object_p runtime::clone_if_dynamic(object_p obj)
 // ----------------------------------------------------------------------------
 //   Clone object if it is in memory
@@ -1113,7 +1358,10 @@ object_p runtime::local(uint index)
         invalid_local_error();
         return nullptr;
     }
-    return Locals[index];
+    object_p obj = Locals[index];
+    if (obj == counter_variable())
+        obj = loop_counter(index);
+    return obj;
 }
 
 
@@ -1354,6 +1602,11 @@ bool runtime::run_select_start_step(bool for_loop, bool has_step)
 // ----------------------------------------------------------------------------
 //   Select evaluation branches in a for loop
 // ----------------------------------------------------------------------------
+//   When the first and last values are small integers, the loop frame holds
+//   the raw counter, last value and, for FOR loops, the depth of the loop
+//   variable, each after a counter mark. The garbage collector skips the
+//   cell following a mark. Otherwise, the frame holds counter and last value
+//   as objects, and they are updated with generic arithmetic.
 {
     if (Returns + 4 > HighMem)
     {
@@ -1365,6 +1618,38 @@ bool runtime::run_select_start_step(bool for_loop, bool has_step)
         return false;
     }
 
+    if (counter_mark(Returns[0]))
+    {
+        // Fast path: native arithmetic without allocating anything
+        size_t   frame = for_loop ? 6 : 4;
+        intptr_t icur  = intptr_t(Returns[1]);
+        intptr_t ilast = intptr_t(Returns[3]);
+        intptr_t istep = 1;
+        if (!has_step || (depth() && small_counter(top(), istep)))
+        {
+            icur += istep;
+            if (icur >= -NATIVE_COUNTER_MAX && icur <= NATIVE_COUNTER_MAX)
+            {
+                if (has_step)
+                    drop();
+                bool finished = istep < 0 ? icur < ilast : icur > ilast;
+                Returns[1] = object_p(icur);
+                if (for_loop)
+                    local(0, counter_variable());
+                return run_select_counted(finished, for_loop, has_step, frame);
+            }
+        }
+
+        // Counter leaves the native range: replace frame with objects
+        object_g cur  = integer::make(intptr_t(Returns[1]));
+        object_g last = integer::make(ilast);
+        if (!cur || !last)
+            return false;
+        run_pop(frame - 2);
+        Returns[0] = cur;
+        Returns[1] = last;
+    }
+
     bool down = false;
     algebraic_g step;
     if (has_step)
@@ -1412,24 +1697,122 @@ bool runtime::run_select_start_step(bool for_loop, bool has_step)
     if (finished < 0)
         return false;
 
+    return run_select_counted(finished, for_loop, has_step, 2);
+}
+
+
+bool runtime::run_select_counted(bool finished, bool for_loop, bool has_step,
+                                 size_t frame)
+// ----------------------------------------------------------------------------
+//   Leave a counted loop, or schedule its next iteration
+// ----------------------------------------------------------------------------
+//   The frame is the number of cells holding the counter, followed by the
+//   body of the loop
+{
     if (finished)
     {
-        if ((HighMem - Returns) % CALLS_BLOCK <= 4)
-            call_stack_drop();
-        Returns += 4;
+        run_pop(frame + 2);
     }
     else
     {
         object::id type = object::id(object::ID_start_next_conditional
                                      + 2*for_loop
                                      + has_step);
-        return object::defer(type) && run_push_data(Returns[4], Returns[5]);
+        return object::defer(type) &&
+            run_push_data(Returns[frame + 2], Returns[frame + 3]);
     }
 
     return true;
 }
 
 
+bool runtime::small_counter(object_p obj, intptr_t &value)
+// ----------------------------------------------------------------------------
+//   Check if an object is an integer that fits in a native loop counter
+// ----------------------------------------------------------------------------
+{
+    if (!obj)
+        return false;
+    object::id ty = obj->type();
+    if (ty != object::ID_integer && ty != object::ID_neg_integer)
+        return false;
+    integer_p i = integer_p(obj);
+    if (leb128size(object::payload(i)) > 4) // 28 bits at most
+        return false;
+    intptr_t v = i->value<uint32_t>();
+    if (v > NATIVE_COUNTER_MAX)
+        return false;
+    value = ty == object::ID_neg_integer ? -v : v;
+    return true;
+}
+
+
+bool runtime::run_push_counter(object_p mark, intptr_t value)
+// ----------------------------------------------------------------------------
+//   Push a raw value after a counter mark on the return stack
+// ----------------------------------------------------------------------------
+//   Unlike run_push_data, the value is not protected as a GC pointer
+{
+    object_p none = nullptr;
+    if ((HighMem - Returns) % CALLS_BLOCK == 0)
+        if (!call_stack_grow(none, none))
+            return false;
+    *(--Returns) = object_p(value);
+    *(--Returns) = mark;
+    return true;
+}
+
+
+void runtime::run_pop(size_t cells)
+// ----------------------------------------------------------------------------
+//   Drop pairs of cells from the return stack, releasing emptied blocks
+// ----------------------------------------------------------------------------
+{
+    for (; cells; cells -= 2)
+    {
+        Returns += 2;
+        if ((HighMem - Returns) % CALLS_BLOCK == 0)
+            call_stack_drop();
+    }
+}
+
+
+object_p runtime::counter_variable()
+// ----------------------------------------------------------------------------
+//   Placeholder for a FOR loop variable whose counter is native
+// ----------------------------------------------------------------------------
+//   This is a valid read-only object, so that walking the locals is safe,
+//   and one that cannot otherwise be the value of a local variable
+{
+    return command::static_object(object::ID_for_next_conditional);
+}
+
+
+object_p runtime::loop_counter(uint index)
+// ----------------------------------------------------------------------------
+//   Find the native counter for the loop variable at index, make an integer
+// ----------------------------------------------------------------------------
+//   FOR loop frames record the depth of their variable in the locals
+{
+    intptr_t depth = Directories - (Locals + index);
+    for (object_p *r = Returns; r + 6 <= HighMem; r += 2)
+    {
+        if (r[0] == start_mark())
+        {
+            r += 2;
+        }
+        else if (r[0] == for_mark())
+        {
+            if (intptr_t(r[5]) == depth)
+                return integer::make(intptr_t(r[1]));
+            r += 4;
+        }
+    }
+    invalid_local_error();
+    return nullptr;
+}
+
+
 bool runtime::run_select_case(bool condition)
 // ----------------------------------------------------------------------------
 //   Select evaluation branches in a case statement
@@ -1514,6 +1897,72 @@ void runtime::call_stack_drop()
 #endif // DM42
 
 
+
+// ============================================================================
+//
+//   Side caches in the C heap
+//
+// ============================================================================
+
+side_cache *side_cache::caches = nullptr;
+size_t      side_cache::total  = 0;
+
+
+side_cache::side_cache(release_fn purge)
+// ----------------------------------------------------------------------------
+//   Register a side cache with the function that releases its memory
+// ----------------------------------------------------------------------------
+    : purge(purge), used(0), next(caches)
+{
+    caches = this;
+}
+
+
+void *side_cache::resize(void *ptr, size_t old, size_t size)
+// ----------------------------------------------------------------------------
+//   Like realloc, but staying within the budget shared by side caches
+// ----------------------------------------------------------------------------
+//   Other caches are released if the budget would be exceeded. On failure,
+//   this returns nullptr and leaves ptr untouched.
+{
+    if (size > old)
+    {
+        size_t grow = size - old;
+        for (side_cache *c = caches; c && total + grow > BUDGET; c = c->next)
+            if (c != this && c->used)
+                c->purge();
+        if (total + grow > BUDGET)
+        {
+            record(runtime, "Side cache %p cannot grow by %u, %u/%u used",
+                   this, grow, total, BUDGET);
+            return nullptr;
+        }
+    }
+
+    void *result = realloc(ptr, size);
+    if (result)
+    {
+        total += size - old;
+        used  += size - old;
+    }
+    return result;
+}
+
+
+void side_cache::release(void *ptr, size_t size)
+// ----------------------------------------------------------------------------
+//   Free memory allocated by resize
+// ----------------------------------------------------------------------------
+{
+    if (ptr)
+    {
+        free(ptr);
+        total -= size;
+        used  -= size;
+    }
+}
+
+
 // ============================================================================
 //
 //   Generation of the error functions
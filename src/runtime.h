@@ -120,6 +120,11 @@ struct runtime
     //   Reset to initial state
     // ------------------------------------------------------------------------
 
+    byte *replace_globals(size_t size);
+    // ------------------------------------------------------------------------
+    //   Reset and reserve a globals area that the caller fills with a home
+    // ------------------------------------------------------------------------
+
     // Amount of space we want to keep between stack top and temporaries
     const uint redzone = 2*sizeof(object_p);;
 
@@ -163,6 +168,11 @@ struct runtime
     //   Clone values in the stack that point to a global we will change
     // ------------------------------------------------------------------------
 
+    bool clone_global(object_p source, size_t size);
+    // ------------------------------------------------------------------------
+    //   Clone values in the stack that point inside a global we will change
+    // ------------------------------------------------------------------------
+
     object_p clone_if_dynamic(object_p source);
     // ------------------------------------------------------------------------
     //   Clone value if it is in RAM (i.e. not a command::static_object)
@@ -292,6 +302,63 @@ struct runtime
     //   Garbage collector (purge unused objects from memory to make space)
     // ------------------------------------------------------------------------
 
+    size_t gc_roots(object_p first, object_p last,
+                    object_p *roots, size_t max);
+    // ------------------------------------------------------------------------
+    //   Collect sorted pointers to objects between first and last
+    // ------------------------------------------------------------------------
+
+
+    struct statistics
+    // ------------------------------------------------------------------------
+    //   Running memory management counters, for benchmarks and tuning
+    // ------------------------------------------------------------------------
+    {
+        size_t allocated;       // Bytes allocated in temporaries and scratch
+        size_t recycled;        // Bytes recycled by garbage collection
+        size_t moved;           // Bytes moved by garbage collection
+        uint   collections;     // Number of garbage collections
+        uint   gc_time;         // Cumulative garbage collection time (ms)
+    };
+
+    struct attribution
+    // ------------------------------------------------------------------------
+    //   Memory allocated while evaluating a given command
+    // ------------------------------------------------------------------------
+    {
+        uint     type;          // Evaluated type (an object::id)
+        uint     collections;   // Garbage collections while evaluating
+        uint     calls;         // Number of evaluations that allocated
+        size_t   allocated;     // Bytes allocated while evaluating
+    };
+    enum { ATTRIBUTIONS = 16 };
+
+    const statistics &stats() const
+    // ------------------------------------------------------------------------
+    //   Return the memory management counters
+    // ------------------------------------------------------------------------
+    {
+        return Stats;
+    }
+
+    const attribution *attributions() const
+    // ------------------------------------------------------------------------
+    //   Return the per-command allocation table (ATTRIBUTIONS entries)
+    // ------------------------------------------------------------------------
+    {
+        return Attributions;
+    }
+
+    void attribute(uint type, size_t allocated, uint collections);
+    // ------------------------------------------------------------------------
+    //   Charge allocations since the given counters to a command type
+    // ------------------------------------------------------------------------
+
+    void reset_stats();
+    // ------------------------------------------------------------------------
+    //   Reset memory management counters and per-command attribution
+    // ------------------------------------------------------------------------
+
 
     void move(object_p to, object_p from,
               size_t sz, size_t overscan = 0, bool scratch=false);
@@ -531,7 +598,7 @@ struct runtime
         {
             object_p next = Returns[0];
             object_p end  = Returns[1] + 1;
-            if (next < end)
+            if (next < end && !counter_mark(next))
             {
                 if (next)
                 {
@@ -594,6 +661,64 @@ struct runtime
     //   Select the next branch in for-next, for-step, start-next or start-step
     // ------------------------------------------------------------------------
 
+    bool run_select_counted(bool finished, bool for_loop, bool has_step,
+                            size_t frame);
+    // ------------------------------------------------------------------------
+    //   Exit a counted loop or schedule its next iteration
+    // ------------------------------------------------------------------------
+
+    // Loop counters up to this size are kept as native integers
+    enum { NATIVE_COUNTER_MAX = 1 << 27 };
+
+    static bool small_counter(object_p obj, intptr_t &value);
+    // ------------------------------------------------------------------------
+    //   Check if an object is an integer small enough for a native counter
+    // ------------------------------------------------------------------------
+
+    bool run_push_counter(object_p mark, intptr_t value);
+    // ------------------------------------------------------------------------
+    //   Push a raw value on the return stack, after a counter mark
+    // ------------------------------------------------------------------------
+
+    void run_pop(size_t cells);
+    // ------------------------------------------------------------------------
+    //   Drop the given number of cells from the return stack
+    // ------------------------------------------------------------------------
+
+    static object_p for_mark()
+    // ------------------------------------------------------------------------
+    //   Mark for the native counter of a FOR loop
+    // ------------------------------------------------------------------------
+    {
+        return object_p(CounterMarks);
+    }
+
+    static object_p start_mark()
+    // ------------------------------------------------------------------------
+    //   Mark for the native counter of a START loop
+    // ------------------------------------------------------------------------
+    {
+        return object_p(CounterMarks + 1);
+    }
+
+    static bool counter_mark(object_p obj)
+    // ------------------------------------------------------------------------
+    //   Check if a return stack cell marks a raw value in the next cell
+    // ------------------------------------------------------------------------
+    {
+        return obj >= object_p(CounterMarks) && obj < object_p(CounterMarks+2);
+    }
+
+    static object_p counter_variable();
+    // ------------------------------------------------------------------------
+    //   Value of a FOR loop variable while its counter is native
+    // ------------------------------------------------------------------------
+
+    object_p loop_counter(uint index);
+    // ------------------------------------------------------------------------
+    //   Build the integer for a FOR loop variable with a native counter
+    // ------------------------------------------------------------------------
+
     bool run_select_case(bool condition);
     // ------------------------------------------------------------------------
     //   Select true or false case for case statement
@@ -901,6 +1026,22 @@ struct runtime
     // ------------------------------------------------------------------------
 
 
+    bool is_global(object_p obj) const
+    // ------------------------------------------------------------------------
+    //   Check if an object is in the globals area, where it may change
+    // ------------------------------------------------------------------------
+    {
+        return obj >= LowMem && obj < Globals;
+    }
+
+    bool is_allocated(object_p obj) const
+    // ------------------------------------------------------------------------
+    //   Check if an object is a global or a temporary, i.e. not in scratch
+    // ------------------------------------------------------------------------
+    {
+        return obj >= LowMem && obj < Temporaries;
+    }
+
     bool is_user_command(utf8 cmd)
     // ------------------------------------------------------------------------
     //   Check if the command is a user-defined command
@@ -951,9 +1092,14 @@ protected:
     object_p *Returns;      // Start of return stack, end of locals
     object_p *HighMem;      // End of available memory
     bool      SaveArgs;     // Save arguents (LastArgs)
+    statistics Stats;       // Memory management counters
+    attribution Attributions[ATTRIBUTIONS]; // Heaviest allocating commands
 
     // Pointers that are GC-adjusted
     static gcptr *GCSafe;
+
+    // Return stack marks for raw loop counters, never dereferenced
+    static byte CounterMarks[2];
 };
 
 template<typename T>
@@ -1022,6 +1168,7 @@ const Obj *runtime::make(typename Obj::id type, const
         return nullptr;    // Failed to allocate
     Obj *result = (Obj *) Temporaries;
     Temporaries = (object *) ((byte *) Temporaries + size);
+    Stats.allocated += size;
 
     // Move the editor up (available() checked we have room)
     move(Temporaries, (object_p) result, Editing + Scratch, 1, true);
@@ -1102,4 +1249,33 @@ struct stack_depth_restore
     size_t depth;
 };
 
+
+struct side_cache
+// ----------------------------------------------------------------------------
+//   A cache in the C heap, sharing a small byte budget with the others
+// ----------------------------------------------------------------------------
+//   The C heap is only about 10K on the calculator, and the system and the
+//   font cache also need it. When a side cache would exceed the budget, the
+//   other caches are released first, and if that is not enough, the cache
+//   is simply not built and its owner falls back to the uncached path.
+{
+    typedef void (*release_fn)();
+    side_cache(release_fn purge);
+
+    void *      resize(void *ptr, size_t old, size_t size);
+    void        release(void *ptr, size_t size);
+
+    static size_t allocated()   { return total; }
+
+    enum { BUDGET = 4096 };     // Bytes shared by all side caches
+
+private:
+    release_fn  purge;          // Release all the memory of this cache
+    size_t      used;           // Bytes allocated by this cache
+    side_cache *next;           // Next cache in the list
+
+    static side_cache *caches;  // List of all side caches
+    static size_t      total;   // Bytes allocated by all side caches
+};
+
 #endif // RUNTIME_H
@@ -43,6 +43,10 @@
 RECORDER(solve,         16, "Numerical solver");
 RECORDER(solve_error,   16, "Numerical solver errors");
 
+// Statistics about the last solver run
+uint solver_iterations  = 0;
+uint solver_evaluations = 0;
+
 
 COMMAND_BODY(Root)
 // ----------------------------------------------------------------------------
@@ -101,14 +105,49 @@ COMMAND_BODY(Root)
 
 
 
+COMMAND_BODY(SolverIterationCount)
+// ----------------------------------------------------------------------------
+//   Return the number of iterations used by the last solver run
+// ----------------------------------------------------------------------------
+{
+    if (rt.args(0))
+        if (integer_p it = integer::make(solver_iterations))
+            if (rt.push(it))
+                return OK;
+    return ERROR;
+}
+
+
+COMMAND_BODY(SolverEvaluations)
+// ----------------------------------------------------------------------------
+//   Return the number of evaluations of the equation in last solver run
+// ----------------------------------------------------------------------------
+{
+    if (rt.args(0))
+        if (integer_p ev = integer::make(solver_evaluations))
+            if (rt.push(ev))
+                return OK;
+    return ERROR;
+}
+
+
+static inline algebraic_p solver_function(program_r eq, algebraic_r x)
+// ----------------------------------------------------------------------------
+//   Evaluate the equation, counting evaluations
+// ----------------------------------------------------------------------------
+{
+    solver_evaluations++;
+    return algebraic::evaluate_function(eq, x);
+}
+
+
 algebraic_p solve(program_g eq, symbol_g name, object_g guess)
 // ----------------------------------------------------------------------------
 //   The core of the solver
 // ----------------------------------------------------------------------------
 {
     // Check if the guess is an algebraic or if we need to extract one
-    algebraic_g x, dx, lx, hx;
-    algebraic_g y, dy, ly, hy;
+    algebraic_g lx, hx, y;
     object::id gty = guess->type();
     if (object::is_real(gty) || object::is_complex(gty))
     {
@@ -124,14 +163,64 @@ algebraic_p solve(program_g eq, symbol_g name, object_g guess)
         if (!lx || !hx)
             return nullptr;
     }
-    x = lx;
+    else
+    {
+        rt.bad_guess_error();
+        return nullptr;
+    }
     record(solve, "Initial range %t-%t", +lx, +hx);
 
     // Set independent variable
     save<symbol_g *> iref(expression::independent, &name);
-    int              prec = Settings.SolverPrecision();
-    algebraic_g      eps = decimal::make(1, -prec);
+    solver_iterations = 0;
+    solver_evaluations = 0;
+    bool real   = lx->is_real() && hx->is_real();
+    bool hybrid = Settings.HybridSolver() && real;
+
+    // Converge at reduced precision first, doubling the digits each time
+    // Each pass starts from the previous root, so that the last one, at
+    // full precision, only needs a few iterations to polish the result
+    const uint FIRST = 6;       // Digits for the first pass
+    const uint GUARD = 3;       // Additional digits for evaluation
+    uint       goal  = Settings.SolverPrecision();
+    uint       full  = Settings.Precision();
+    for (uint d = FIRST; real && d < goal && d + GUARD < full; d *= 2)
+    {
+        settings::SavePrecision       saved_precision(d + GUARD);
+        settings::SaveSolverPrecision saved_solver_precision(d);
+        algebraic_g x = hybrid ? hybrid_solve(eq, lx, hx)
+                               : secant_solve(eq, lx, hx);
+        if (!x || rt.error() || !x->is_real())
+        {
+            // Let the full precision pass report the error if any
+            rt.clear_error();
+            break;
+        }
+        record(solve, "Reduced %u digits pass root=%t", d, +x);
+        algebraic_g dx = decimal::make(1, -int(d));
+        lx = x;
+        hx = x->is_zero() ? dx : x + x * dx;
+        if (!hx)
+            return nullptr;
+    }
+
+    if (hybrid)
+        return hybrid_solve(eq, lx, hx);
+    return secant_solve(eq, lx, hx);
+}
+
+
+algebraic_p secant_solve(program_r eq, algebraic_g lx, algebraic_g hx)
+// ----------------------------------------------------------------------------
+//   Secant solver, jittering around when not making progress
+// ----------------------------------------------------------------------------
+{
+    algebraic_g x, dx;
+    algebraic_g y, dy, ly, hy;
+    int         prec = Settings.SolverPrecision();
+    algebraic_g eps = decimal::make(1, -prec);
 
+    x = lx;
     bool is_constant = true;
     bool is_valid = false;
     uint max = Settings.SolverIterations();
@@ -140,7 +229,8 @@ algebraic_p solve(program_g eq, symbol_g name, object_g guess)
         bool           jitter = false;
 
         // Evaluate equation
-        y = algebraic::evaluate_function(eq, x);
+        solver_iterations++;
+        y = solver_function(eq, x);
         record(solve, "[%u] x=%t y=%t", i, +x, +y);
         if (!y)
         {
@@ -305,3 +395,236 @@ algebraic_p solve(program_g eq, symbol_g name, object_g guess)
         rt.no_solution_error();
     return lx;
 }
+
+
+static bool solver_less(algebraic_r x, algebraic_r y)
+// ----------------------------------------------------------------------------
+//   Check if x < y for real values
+// ----------------------------------------------------------------------------
+{
+    int cmp = 0;
+    return comparison::compare(&cmp, x, y) && cmp < 0;
+}
+
+
+algebraic_p hybrid_solve(program_r eq, algebraic_g a, algebraic_g b)
+// ----------------------------------------------------------------------------
+//   Brent solver, with Newton steps using finite-difference slopes
+// ----------------------------------------------------------------------------
+//   Until the root is bracketed, take Newton steps with the slope through
+//   the two most recent points, expanding the search if the slope is flat.
+//   Once the sign changes, this is Brent's method: inverse quadratic
+//   interpolation when three distinct points are known, Newton step with
+//   the secant slope otherwise, accepted only if the step falls well within
+//   the bracket, and bisection in all other cases. The bracket [b, c] always
+//   contains the root, and derivatives only use points already evaluated.
+{
+    algebraic_g fa, fb, c, fc, d, e, m, p, q, r, s, tol;
+    algebraic_g one   = integer::make(1);
+    algebraic_g two   = integer::make(2);
+    algebraic_g three = integer::make(3);
+    algebraic_g grow  = integer::make(64);
+    int         prec  = Settings.SolverPrecision();
+    algebraic_g eps   = decimal::make(1, -prec);
+    algebraic_g tiny  = eps * eps;
+    uint        max   = Settings.SolverIterations();
+    uint        i     = 0;
+    bool        worse = false;
+
+    fa = solver_function(eq, a);
+    fb = fa ? solver_function(eq, b) : nullptr;
+    if (!fb)
+    {
+        // Let the secant solver jitter around a bad initial guess
+        record(solve_error, "Hybrid got error %+s", rt.error());
+        rt.clear_error();
+        return secant_solve(eq, a, b);
+    }
+
+    // Search for a sign change with Newton steps
+    for (; i < max && !program::interrupted(); i++)
+    {
+        // Keep b as the best point so far
+        if (smaller_magnitude(fa, fb))
+        {
+            c = a;  a = b;  b = c;
+            fc = fa; fa = fb; fb = fc;
+        }
+        if (fb->is_zero() || smaller_magnitude(fb, eps))
+        {
+            record(solve, "[%u] Newton solution=%t value=%t", i, +b, +fb);
+            return b;
+        }
+        s = fa * fb;
+        if (!s)
+            return nullptr;
+        if (s->is_negative(false))
+            break;
+
+        // Check if we converged without crossing zero
+        solver_iterations++;
+        d = b - a;
+        r = fb - fa;
+        if (!d || !r)
+            return nullptr;
+        if (d->is_zero() ||
+            smaller_magnitude(abs::run(d) / (abs::run(a) + abs::run(b)), eps))
+        {
+            record(solve, "[%u] Minimum=%t value=%t", i, +b, +fb);
+            rt.no_solution_error();
+            return b;
+        }
+
+        // Newton step with the slope through a and b, within limits
+        if (worse)
+        {
+            // Last step made things worse, move back halfway
+            s = -(d / two);
+        }
+        else if (r->is_zero())
+        {
+            // Flat slope, expand the search
+            s = d * two;
+        }
+        else
+        {
+            s = -(fb * d / r);
+            m = d * grow;
+            if (s && m && smaller_magnitude(m, s))
+                s = s->is_negative(false) ? -abs::run(m) : abs::run(m);
+        }
+        a = b;
+        fa = fb;
+        b = s ? b + s : nullptr;
+        if (!b || !algebraic::to_decimal_if_big(b))
+            return nullptr;
+        if (b->is_symbolic())
+        {
+            rt.invalid_function_error();
+            return b;
+        }
+        record(solve, "[%u] Newton step to %t", i, +b);
+
+        fb = solver_function(eq, b);
+        if (!fb)
+        {
+            // Step outside of the domain of the function: retreat halfway
+            rt.clear_error();
+            b = (a + b) / two;
+            fb = b ? solver_function(eq, b) : nullptr;
+            if (!fb)
+                return nullptr;
+        }
+        worse = smaller_magnitude(fa, fb);
+    }
+
+    // Brent's method on the bracket
+    c = a;
+    fc = fa;
+    d = b - a;
+    e = d;
+    for (; i < max && !program::interrupted(); i++)
+    {
+        solver_iterations++;
+
+        // Make sure that [b, c] brackets the root, and that b is the best
+        s = fb * fc;
+        if (!s)
+            return nullptr;
+        if (!s->is_negative(false))
+        {
+            c = a;
+            fc = fa;
+            d = b - a;
+            e = d;
+        }
+        if (smaller_magnitude(fc, fb))
+        {
+            a = b;  b = c;  c = a;
+            fa = fb; fb = fc; fc = fa;
+        }
+
+        // Check convergence
+        tol = abs::run(b) * eps;
+        m = (c - b) / two;
+        if (!tol || !m)
+            return nullptr;
+        if (tol->is_zero())
+            tol = tiny;
+        if (fb->is_zero() || smaller_magnitude(fb, eps) ||
+            !smaller_magnitude(tol, m))
+        {
+            record(solve, "[%u] Brent solution=%t value=%t", i, +b, +fb);
+            return b;
+        }
+
+        if (smaller_magnitude(e, tol) || !smaller_magnitude(fb, fa))
+        {
+            // Bisection
+            d = m;
+            e = m;
+        }
+        else
+        {
+            s = fb / fa;
+            r = a - c;
+            if (!s || !r)
+                return nullptr;
+            if (r->is_zero())
+            {
+                // Newton step with the secant slope
+                p = two * m * s;
+                q = one - s;
+            }
+            else
+            {
+                // Inverse quadratic interpolation
+                q = fa / fc;
+                r = fb / fc;
+                p = s * (two * m * q * (q - r) - (b - a) * (r - one));
+                q = (q - one) * (r - one) * (s - one);
+            }
+            if (!p || !q)
+                return nullptr;
+            if (p->is_negative(false) || p->is_zero())
+                p = -p;
+            else
+                q = -q;
+
+            // Accept the step if it falls well within the bracket
+            r = three * m * q - abs::run(tol * q);
+            s = abs::run(e * q / two);
+            if (!r || !s)
+                return nullptr;
+            if (solver_less(two * p, r) && solver_less(p, s))
+            {
+                e = d;
+                d = p / q;
+            }
+            else
+            {
+                d = m;
+                e = m;
+            }
+        }
+
+        // Move by at least the tolerance
+        a = b;
+        fa = fb;
+        if (smaller_magnitude(tol, d))
+            b = b + d;
+        else
+            b = m->is_negative(false) ? b - tol : b + tol;
+        if (!b || !algebraic::to_decimal_if_big(b))
+            return nullptr;
+        record(solve, "[%u] Brent step to %t", i, +b);
+
+        fb = solver_function(eq, b);
+        if (!fb)
+            return nullptr;
+    }
+
+    record(solve, "Hybrid exited after too many loops, b=%t fb=%t", +b, +fb);
+    rt.no_solution_error();
+    return b;
+}
@@ -34,7 +34,15 @@
 #include "symbol.h"
 
 algebraic_p solve(program_g eq, symbol_g name, object_g guess);
+algebraic_p secant_solve(program_r eq, algebraic_g low, algebraic_g high);
+algebraic_p hybrid_solve(program_r eq, algebraic_g low, algebraic_g high);
+
+// Statistics about the last solver run
+extern uint solver_iterations;
+extern uint solver_evaluations;
 
 COMMAND_DECLARE(Root);
+COMMAND_DECLARE(SolverIterationCount);
+COMMAND_DECLARE(SolverEvaluations);
 
 #endif // SOLVE_H
@@ -35,10 +35,13 @@
 #include "runtime.h"
 #include "settings.h"
 #include "target.h"
+#include "text.h"
 #include "user_interface.h"
 #include "utf8.h"
 
 #include <dmcp.h>
+#include <stdlib.h>
+#include <string.h>
 
 
 stack    Stack;
@@ -60,6 +63,158 @@ stack::stack()
 }
 
 
+// ============================================================================
+//
+//   Render cache
+//
+// ============================================================================
+//   Rendering large objects, notably in graphic mode, is expensive, and most
+//   of the time only the first level of the stack changed. We keep the text
+//   or grob rendered for each level as an object in the runtime, keyed on the
+//   object and display parameters. Both are referenced through GC-safe
+//   pointers, so they follow temporaries when globals move. The garbage
+//   collector clears the cache before scanning roots, so that renderings
+//   are recycled like any other unreferenced temporary when memory is short.
+//   Objects in the globals area can change in place, so they are never
+//   cached. A change in settings also clears the cache.
+
+struct stack_cache
+// ----------------------------------------------------------------------------
+//   A small LRU cache of rendered stack levels
+// ----------------------------------------------------------------------------
+{
+    enum { SLOTS = 12 };
+
+    struct entry
+    {
+        object_g        object;         // Object that was rendered
+        object_g        data;           // Rendered text or grob
+        size            avail;          // Available width (graphics)
+        size            height;         // Available height (graphics)
+        bool            graph;          // Graphic rendering
+        bool            result;         // Rendered as level 1
+        uint            used;           // Last use, for LRU eviction
+        size            width;          // Width of text
+    };
+
+    entry       entries[SLOTS];
+    uint        clock;                  // Clock for LRU eviction
+    uint32_t    settings;               // Hash of the settings
+
+    const entry *find(object_p obj, size avail, size height,
+                      bool graph, bool result);
+    void         add(object_p obj, size avail, size height,
+                     bool graph, bool result, object_p data, size width);
+    void         evict(entry *e);
+    void         check_settings();
+    void         clear();
+};
+
+static stack_cache StackCache;
+
+
+const stack_cache::entry *stack_cache::find(object_p obj,
+                                            size avail, size height,
+                                            bool graph, bool result)
+// ----------------------------------------------------------------------------
+//   Find a rendering for the given object
+// ----------------------------------------------------------------------------
+{
+    for (uint i = 0; i < SLOTS; i++)
+    {
+        entry *e = entries + i;
+        if (e->data && +e->object == obj &&
+            e->avail == avail && e->height == height &&
+            e->graph == graph && e->result == result)
+        {
+            e->used = ++clock;
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+
+void stack_cache::add(object_p obj, size avail, size height,
+                      bool graph, bool result, object_p data, size width)
+// ----------------------------------------------------------------------------
+//   Record a rendering, evicting the least recently used one if needed
+// ----------------------------------------------------------------------------
+{
+    if (!data)
+        return;
+
+    entry *slot = nullptr;
+    for (uint i = 0; i < SLOTS; i++)
+    {
+        entry *e = entries + i;
+        if (!e->data)
+        {
+            slot = e;
+            break;
+        }
+        if (!slot || e->used < slot->used)
+            slot = e;
+    }
+
+    slot->object = obj;
+    slot->data   = data;
+    slot->avail  = avail;
+    slot->height = height;
+    slot->graph  = graph;
+    slot->result = result;
+    slot->used   = ++clock;
+    slot->width  = width;
+}
+
+
+void stack_cache::evict(entry *e)
+// ----------------------------------------------------------------------------
+//   Evict a given entry
+// ----------------------------------------------------------------------------
+{
+    e->data = nullptr;
+    e->object = nullptr;
+}
+
+
+void stack_cache::check_settings()
+// ----------------------------------------------------------------------------
+//   Clear the cache if the settings changed since last time
+// ----------------------------------------------------------------------------
+{
+    byte_p   p    = byte_p(&Settings);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(Settings); i++)
+        hash = (hash ^ p[i]) * 16777619u;
+    if (hash != settings)
+    {
+        clear();
+        settings = hash;
+    }
+}
+
+
+void stack_cache::clear()
+// ----------------------------------------------------------------------------
+//   Clear the whole cache
+// ----------------------------------------------------------------------------
+{
+    for (uint i = 0; i < SLOTS; i++)
+        if (entries[i].data)
+            evict(entries + i);
+}
+
+
+void stack::clear_cache()
+// ----------------------------------------------------------------------------
+//   Forget cached renderings, e.g. because objects moved in memory
+// ----------------------------------------------------------------------------
+{
+    StackCache.clear();
+}
+
+
 static inline uint countDigits(uint value)
 // ----------------------------------------------------------------------------
 //   Count how many digits we need to display a value
@@ -94,6 +249,8 @@ void stack::draw_stack()
     if (!depth)
         return;
 
+    StackCache.check_settings();
+
     rect clip      = Screen.clip();
 
     Screen.fill(hdrx, top, hdrx, bottom, pattern::gray50);
@@ -115,19 +272,38 @@ void stack::draw_stack()
         if (coord(y) <= top)
             break;
 
-        grob_g   graph = nullptr;
-        object_g obj   = rt.stack(level);
-        size     w = 0;
+        grob_g   graph  = nullptr;
+        grob_p   shown  = nullptr;
+        object_g obj    = rt.stack(level);
+        size     w      = 0;
+        bool     result = level == 0;
+        bool     cache  = !rt.is_global(obj);
         if (Settings.GraphicStackDisplay())
         {
-            auto fid = !level ? Settings.ResultFont() : Settings.StackFont();
-            grapher  g(avail - 2, bottom - top, fid,
-                       pattern::black, pattern::gray90, true);
-            graph = obj->graph(g);
-            size gh = graph->height();
+            size gheight = bottom - top;
+            const stack_cache::entry *cached = cache
+                ? StackCache.find(obj, avail, gheight, true, result)
+                : nullptr;
+            if (cached)
+            {
+                graph = grob_p(+cached->data);
+                shown = graph;
+            }
+            else
+            {
+                auto fid = result ? Settings.ResultFont() : Settings.StackFont();
+                grapher  g(avail - 2, gheight, fid,
+                           pattern::black, pattern::gray90, true);
+                graph = obj->graph(g);
+                shown = graph;
+                if (cache && shown)
+                    StackCache.add(obj, avail, gheight, true, result,
+                                   shown, 0);
+            }
+            size gh = shown->height();
             if (level == 0 && lineHeight < gh)
                 lineHeight = gh;
-            w = graph->width();
+            w = shown->width();
 
 #ifdef SIMULATOR
             if (level == 0)
@@ -148,9 +324,9 @@ void stack::draw_stack()
         coord yb   = y + lineHeight-1;
         Screen.clip(0, ytop, LCD_W, yb);
 
-        if (graph)
+        if (shown)
         {
-            surface s = graph->pixels();
+            surface s = shown->pixels();
             rect r = s.area();
             r.offset(LCD_W - 2 - w, y);
             Screen.copy(s, r);
@@ -161,8 +337,29 @@ void stack::draw_stack()
             bool     ml = (level ? Settings.MultiLineStack()
                                  : Settings.MultiLineResult());
             renderer r(nullptr, ~0U, true, ml);
-            size_t   len = obj->render(r);
-            utf8     out = r.text();
+            size_t   len = 0;
+            utf8     out = nullptr;
+            const stack_cache::entry *cached = cache
+                ? StackCache.find(obj, 0, 0, false, result)
+                : nullptr;
+            if (cached)
+            {
+                out = text_p(+cached->data)->value(&len);
+                w   = cached->width;
+            }
+            else
+            {
+                len = obj->render(r);
+                out = r.text();
+                w   = font->width(out, len);
+                if (cache && rt.available() > len + 8)
+                {
+                    // Making the text moves the scratchpad, and out with it
+                    text_p copy = text::make(out, len);
+                    StackCache.add(obj, 0, 0, false, result, copy, w);
+                    out = r.text();
+                }
+            }
 #ifdef SIMULATOR
             if (level == 0)
             {
@@ -172,7 +369,6 @@ void stack::draw_stack()
                        last_key, object::name(obj->type()), len, out);
             }
 #endif
-            w = font->width(out, len);
 
             if (w >= avail)
             {
@@ -43,6 +43,7 @@ struct stack
     stack();
 
     void draw_stack();
+    void clear_cache();
 
 #if SIMULATOR
 public:
@@ -31,10 +31,407 @@
 
 #include "arithmetic.h"
 #include "compare.h"
+#include "decimal.h"
+#include "fraction.h"
+#include "functions.h"
 #include "integer.h"
 #include "tag.h"
 #include "variables.h"
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// ============================================================================
+//
+//   Running sums
+//
+// ============================================================================
+//   The sums used by summary statistics and fits are kept in a small side
+//   cache in the C heap, keyed on the address and size of the ΣData array.
+//   Like other side caches, it may be released when another one needs the
+//   memory, so sums are copied to runtime memory while being updated.
+//   AddData and RemoveData update them incrementally, so that Total,
+//   Variance, Correlation or LinearRegression do not rescan the data.
+//   The cache follows ΣData when globals move, and is forgotten when ΣData
+//   is overwritten or purged. Sums are then recomputed on demand.
+//   Rounded sums cannot be updated by subtraction without losing the
+//   contribution of the remaining rows, and the single-pass formulas for
+//   variance or correlation cancel badly with decimals. So removing a row
+//   only updates exact sums, and these formulas only use exact sums.
+
+struct stats_sums
+// ----------------------------------------------------------------------------
+//   Running sums for the ΣData array
+// ----------------------------------------------------------------------------
+{
+    enum entry
+    {
+        COUNT,                  // Number of rows
+        SUM_XY,                 // Σx·y
+        SUM_LX,                 // Σln x
+        SUM_LY,                 // Σln y
+        SUM_LX2,                // Σ(ln x)²
+        SUM_LY2,                // Σ(ln y)²
+        SUM_XLY,                // Σx·ln y
+        SUM_LXY,                // Σln x·y
+        SUM_LXLY,               // Σln x·ln y
+        SUM_COLUMNS,            // Σc and Σc² for each column c
+
+        MAX_COLUMNS = 8,
+        ENTRIES     = SUM_COLUMNS + 2 * MAX_COLUMNS
+    };
+
+    enum group
+    {
+        LINEAR  = 1,            // COUNT and column sums
+        PAIRS   = 2,            // SUM_XY for xcol and ycol
+        LOGS    = 4,            // Log sums for xcol and ycol
+    };
+
+    typedef algebraic_g values[ENTRIES];
+
+    array_p     data;           // ΣData array the sums are valid for
+    size_t      size;           // Size of the array when sums were computed
+    array_p     pending;        // New array being written with updated sums
+    size_t      rows;           // Number of rows
+    uint        columns;        // Number of columns
+    uint        xcol, ycol;     // Columns for the PAIRS and LOGS groups
+    uint        valid;          // Groups that are valid
+    byte       *buffer;         // Sums, stored as consecutive objects
+    size_t      length;         // Size of the buffer
+
+    bool        matches(array_p a) const
+    {
+        return a && a == data && a->size() == size;
+    }
+    uint        entries() const         { return SUM_COLUMNS + 2 * columns; }
+    bool        load(values &sums) const;
+    bool        save(values &sums);
+    bool        accumulate(values &sums, object_p row, bool remove, uint g);
+    bool        exact(values &sums) const;
+    bool        update(array_p old, object_p row, bool remove);
+    void        written(object_p stored);
+    void        forget()                { data = nullptr; }
+    void        release();
+
+    static array_p current();
+    static void    purge();
+};
+
+static stats_sums StatsSums;
+static side_cache StatsCache(stats_sums::purge);
+
+
+array_p stats_sums::current()
+// ----------------------------------------------------------------------------
+//   Return the ΣData array visible from the current directory, if any
+// ----------------------------------------------------------------------------
+{
+    object_p obj = directory::recall_all(StatsData::Access::name(), false);
+    return obj ? obj->as<array>() : nullptr;
+}
+
+
+bool stats_sums::load(values &sums) const
+// ----------------------------------------------------------------------------
+//   Load the sums from the cache, or zeroes for groups that are not valid
+// ----------------------------------------------------------------------------
+//   The sums are copied, since the buffer may be released while we compute
+{
+    byte_p p = buffer;
+    for (uint i = 0; i < entries(); i++)
+    {
+        if (p)
+        {
+            sums[i] = algebraic_p(rt.clone(object_p(p)));
+            p += object_p(p)->size();
+        }
+        else
+        {
+            sums[i] = integer::make(0);
+        }
+        if (!sums[i])
+            return false;
+    }
+    return true;
+}
+
+
+bool stats_sums::save(values &sums)
+// ----------------------------------------------------------------------------
+//   Save the sums in a new buffer in the C heap
+// ----------------------------------------------------------------------------
+{
+    uint   count = entries();
+    size_t total = 0;
+    for (uint i = 0; i < count; i++)
+    {
+        if (!sums[i])
+            return false;
+        total += sums[i]->size();
+    }
+
+    byte *copy = (byte *) StatsCache.resize(buffer, length, total);
+    if (!copy)
+    {
+        forget();
+        return false;
+    }
+    buffer = copy;
+    length = total;
+    byte *p = copy;
+    for (uint i = 0; i < count; i++)
+    {
+        size_t size = sums[i]->size();
+        memcpy(p, +sums[i], size);
+        p += size;
+    }
+    return true;
+}
+
+
+void stats_sums::release()
+// ----------------------------------------------------------------------------
+//   Release the buffer, so that the sums need to be recomputed
+// ----------------------------------------------------------------------------
+{
+    StatsCache.release(buffer, length);
+    buffer = nullptr;
+    length = 0;
+}
+
+
+void stats_sums::purge()
+// ----------------------------------------------------------------------------
+//   Release the sums when another side cache needs the memory
+// ----------------------------------------------------------------------------
+{
+    StatsSums.forget();
+    StatsSums.valid = 0;
+    StatsSums.release();
+}
+
+
+bool stats_sums::accumulate(values &sums, object_p row, bool remove, uint g)
+// ----------------------------------------------------------------------------
+//   Add or remove the contributions of one row for the given groups
+// ----------------------------------------------------------------------------
+{
+    algebraic_g x, y, v, t;
+    object_g    robj = row;
+    uint        col  = 1;
+    bool        is_array = row->type() == object::ID_array;
+    array::iterator it  = is_array ? array_p(row)->begin() : array::iterator();
+    array::iterator end = is_array ? array_p(row)->end()   : array::iterator();
+
+    if (g & LINEAR)
+    {
+        t = integer::make(1);
+        sums[COUNT] = remove ? sums[COUNT] - t : sums[COUNT] + t;
+    }
+    while (is_array ? it != end : col == 1)
+    {
+        object_p item = is_array ? *it : +robj;
+        if (!item || col > columns)
+            return false;
+        if (!item->is_real() && !item->is_complex())
+            return false;
+        v = algebraic_p(item);
+        if (col == xcol)
+            x = v;
+        if (col == ycol)
+            y = v;
+        if (g & LINEAR)
+        {
+            algebraic_g &s = sums[SUM_COLUMNS + 2 * (col - 1)];
+            algebraic_g &q = sums[SUM_COLUMNS + 2 * (col - 1) + 1];
+            s = remove ? s - v : s + v;
+            t = v * v;
+            q = remove ? q - t : q + t;
+        }
+        col++;
+        if (is_array)
+            ++it;
+    }
+
+    if (g & (PAIRS | LOGS))
+    {
+        if (!x || !y)
+            return false;
+        uint first = g & PAIRS ? SUM_XY : SUM_LX;
+        uint last  = g & LOGS ? SUM_LXLY : SUM_XY;
+        algebraic_g lx = g & LOGS ? log::evaluate(x) : nullptr;
+        algebraic_g ly = g & LOGS ? log::evaluate(y) : nullptr;
+        if ((g & LOGS) && (!lx || !ly))
+            return false;
+        for (uint e = first; e <= last; e++)
+        {
+            switch(e)
+            {
+            case SUM_XY:        t = x * y;      break;
+            case SUM_LX:        t = lx;         break;
+            case SUM_LY:        t = ly;         break;
+            case SUM_LX2:       t = lx * lx;    break;
+            case SUM_LY2:       t = ly * ly;    break;
+            case SUM_XLY:       t = x * ly;     break;
+            case SUM_LXY:       t = lx * y;     break;
+            case SUM_LXLY:      t = lx * ly;    break;
+            }
+            sums[e] = remove ? sums[e] - t : sums[e] + t;
+        }
+    }
+
+    for (uint i = 0; i < entries(); i++)
+        if (!sums[i])
+            return false;
+    return true;
+}
+
+
+bool stats_sums::exact(values &sums) const
+// ----------------------------------------------------------------------------
+//   Check if the linear and pair sums are integers or fractions
+// ----------------------------------------------------------------------------
+{
+    for (uint i = 0; i < entries(); i++)
+        if (i < SUM_LX || i >= SUM_COLUMNS)
+            if (sums[i] && !sums[i]->is_fractionable())
+                return false;
+    return true;
+}
+
+
+static bool is_exact(algebraic_p value)
+// ----------------------------------------------------------------------------
+//   Check if a sum or all the sums in an array are integers or fractions
+// ----------------------------------------------------------------------------
+{
+    if (!value)
+        return false;
+    if (array_p a = value->as<array>())
+    {
+        for (object_p item : *a)
+            if (!item->is_fractionable())
+                return false;
+        return true;
+    }
+    return value->is_fractionable();
+}
+
+
+bool stats_sums::update(array_p old, object_p row, bool remove)
+// ----------------------------------------------------------------------------
+//   Update the sums for a row added to or removed from the old data
+// ----------------------------------------------------------------------------
+//   The updated sums become pending until the new array is written
+{
+    pending = nullptr;
+    bool fresh = old && !remove && !old->items();
+    if (fresh)
+    {
+        // Start from empty data with the shape of the new row
+        array_p ra = row->as<array>();
+        columns = ra ? ra->length() : 1;
+        rows = 0;
+        valid = LINEAR;
+        release();
+    }
+    else if (!matches(old))
+    {
+        return false;
+    }
+    if (columns > MAX_COLUMNS)
+    {
+        forget();
+        return false;
+    }
+
+    object_g robj = row;
+    values   sums;
+    if (!load(sums))
+    {
+        forget();
+        return false;
+    }
+    data = nullptr;
+    if (remove)
+    {
+        // Subtracting from rounded sums would not give the remaining sums
+        if (!exact(sums))
+        {
+            forget();
+            return false;
+        }
+        valid &= ~LOGS;
+    }
+    if (!accumulate(sums, robj, remove, valid & (LINEAR | PAIRS)))
+    {
+        forget();
+        return false;
+    }
+    if (valid & LOGS)
+    {
+        // Log sums become invalid if the new row has no logarithm
+        if (!accumulate(sums, robj, remove, LOGS))
+        {
+            rt.clear_error();
+            valid &= ~LOGS;
+        }
+    }
+    if (!save(sums))
+        return false;
+    if (remove)
+        rows--;
+    else
+        rows++;
+    return true;
+}
+
+
+void stats_sums::written(object_p stored)
+// ----------------------------------------------------------------------------
+//   Record where the array for the current sums was stored
+// ----------------------------------------------------------------------------
+{
+    pending = nullptr;
+    data = stored ? stored->as<array>() : nullptr;
+    size = data ? data->size() : 0;
+}
+
+
+void StatsData::sums_invalidate()
+// ----------------------------------------------------------------------------
+//   Forget the running sums, e.g. when ΣData is overwritten
+// ----------------------------------------------------------------------------
+{
+    StatsSums.forget();
+}
+
+
+void StatsData::sums_moved(object_p to, object_p from, object_p last)
+// ----------------------------------------------------------------------------
+//   Adjust the running sums when objects between from and last move to to
+// ----------------------------------------------------------------------------
+//   Like menu labels, the arrays follow the objects they point to. When
+//   moving down, objects between to and from are removed, and if ΣData was
+//   one of them, the sums are forgotten.
+{
+    array_p *arrays[] = { &StatsSums.data, &StatsSums.pending };
+    for (array_p *a : arrays)
+    {
+        object_p obj = *a;
+        if (!obj || obj >= last)
+            continue;
+        if (obj >= from)
+            *a = array_p(obj + (to - from));
+        else if (obj >= to)
+            *a = nullptr;
+    }
+}
+
+
 
 // ============================================================================
 //
@@ -146,8 +543,20 @@ bool StatsParameters::Access::write(object_p name) const
         integer_g yc = integer::make(ycol);
         object_g  m  = command::static_object(model);
         object_g par = list::make(xc, yc, slope, intercept, m);
-        if (par)
-            return dir->store(name, par);
+        if (!par)
+            return false;
+
+        // Do not rewrite unchanged parameters, that would move ΣData
+        object_p existing = dir->recall(name);
+        if (existing && existing->is_same_as(par))
+            return true;
+
+        // Storing parameters may move ΣData, but does not change it
+        bool keep = StatsSums.matches(stats_sums::current());
+        bool ok = dir->store(name, par);
+        if (keep)
+            StatsSums.written(stats_sums::current());
+        return ok;
     }
     return false;
 }
@@ -176,6 +585,7 @@ StatsData::Access::~Access()
 // ----------------------------------------------------------------------------
 {
     write();
+    StatsSums.pending = nullptr;
 }
 
 
@@ -197,6 +607,15 @@ bool StatsData::Access::parse(array_p values)
     if (!values)
         return false;
 
+    // Data with running sums was already checked
+    if (StatsSums.matches(values))
+    {
+        columns = StatsSums.columns;
+        rows    = StatsSums.rows;
+        data    = values;
+        return true;
+    }
+
     columns = 0;
     rows    = 0;
 
@@ -279,7 +698,13 @@ bool StatsData::Access::write(object_p name) const
                 if (nty == object::ID_text || nty == object::ID_symbol)
                     name = existing;
             }
-            return dir->store(name, +data);
+
+            // Running sums that were updated for the new data follow it
+            bool keep = StatsSums.pending && StatsSums.pending == +data;
+            bool ok = dir->store(name, +data);
+            if (keep && ok)
+                StatsSums.written(dir->recall(name));
+            return ok;
         }
     }
     return false;
@@ -336,7 +761,11 @@ COMMAND_BODY(AddData)
 
             if (!stats.data)
                 stats.data = array_p(array::make(ID_array, nullptr, 0));
-            stats.data = stats.data->append(value);
+            object_g row = value;
+            bool sums = StatsSums.update(stats.data, row, false);
+            stats.data = stats.data->append(row);
+            if (sums)
+                StatsSums.pending = stats.data;
             rt.drop();
             return OK;
         }
@@ -371,8 +800,12 @@ COMMAND_BODY(RemoveData)
         if (!rt.push(removed))
             return ERROR;
 
-        size = last - first;
+        bool sums = StatsSums.update(stats.data, removed, true);
+        first = stats.data->objects();
+        size = size - removed->size();
         stats.data = array_p(array::make(ID_array, byte_p(first), size));
+        if (sums && stats.data)
+            StatsSums.pending = stats.data;
         return OK;
     }
     rt.invalid_stats_data_error();
@@ -470,18 +903,204 @@ algebraic_p StatsAccess::fit_transform(algebraic_r x, uint col) const
 //   3. Log fit:        y = a*ln(x) + b
 //   4. Power fit:      ln(y) = a*ln(x) + ln(b)
 {
-    bool dolog = false;
+    if (fit_log(col))
+        return log::evaluate(x);
+    return x;
+}
+
+
+bool StatsAccess::fit_log(uint col) const
+// ----------------------------------------------------------------------------
+//   Check if the current model uses the logarithm of the given column
+// ----------------------------------------------------------------------------
+{
     switch (model)
     {
     default:
-    case object::ID_LinearFit:                                          break;
-    case object::ID_ExponentialFit: dolog = col == ycol;                break;
-    case object::ID_LogarithmicFit: dolog = col == xcol;                break;
-    case object::ID_PowerFit:       dolog = col == xcol || col == ycol; break;
+    case object::ID_LinearFit:      return false;
+    case object::ID_ExponentialFit: return col == ycol;
+    case object::ID_LogarithmicFit: return col == xcol;
+    case object::ID_PowerFit:       return col == xcol || col == ycol;
     }
-    if (dolog)
-        return log::evaluate(x);
-    return x;
+}
+
+
+static algebraic_p running_entry(const StatsAccess &s, uint entry, uint group)
+// ----------------------------------------------------------------------------
+//   Return an entry in the running sums, computing its group if needed
+// ----------------------------------------------------------------------------
+{
+    stats_sums &ss      = StatsSums;
+    size_t      rows    = s.rows;
+    size_t      columns = s.columns;
+    uint        xcol    = s.xcol;
+    uint        ycol    = s.ycol;
+    if (!rows || columns > stats_sums::MAX_COLUMNS || !rt.is_global(s.data))
+        return nullptr;
+
+    // Check which groups need to be computed
+    if (!ss.matches(s.data))
+    {
+        ss.forget();
+        ss.valid = 0;
+        ss.columns = columns;
+        ss.rows = rows;
+    }
+    if (ss.xcol != xcol || ss.ycol != ycol)
+        ss.valid &= stats_sums::LINEAR;
+    uint missing = group & ~ss.valid;
+    if (missing)
+    {
+        if (!ss.valid)
+        {
+            ss.release();
+            missing |= stats_sums::LINEAR;
+        }
+        ss.xcol = xcol;
+        ss.ycol = ycol;
+
+        array_g            values = +s.data;
+        stats_sums::values sums;
+        if (!ss.load(sums))
+            return nullptr;
+        for (uint e = stats_sums::SUM_XY; e < stats_sums::SUM_COLUMNS; e++)
+            if (!(ss.valid & (e == stats_sums::SUM_XY ? stats_sums::PAIRS
+                                                      : stats_sums::LOGS)))
+                sums[e] = integer::make(0);
+        if (missing & stats_sums::LINEAR)
+            for (uint e = 0; e < ss.entries(); e++)
+                if (e == stats_sums::COUNT || e >= stats_sums::SUM_COLUMNS)
+                    sums[e] = integer::make(0);
+        for (object_p row : *values)
+        {
+            if (!ss.accumulate(sums, row, false, missing))
+            {
+                // Let the caller report errors, e.g. logarithm of zero
+                rt.clear_error();
+                return nullptr;
+            }
+        }
+        if (!ss.save(sums))
+            return nullptr;
+        ss.valid |= missing;
+        ss.data = values;
+        ss.size = values->size();
+    }
+
+    // Return a copy, since the buffer changes when sums are updated
+    byte_p p = ss.buffer;
+    for (uint e = 0; p && e < entry; e++)
+        p += object_p(p)->size();
+    return p ? algebraic_p(rt.clone(object_p(p))) : nullptr;
+}
+
+
+algebraic_p StatsAccess::running_sum(running which) const
+// ----------------------------------------------------------------------------
+//   Return a sum from the running sums, computing missing ones if needed
+// ----------------------------------------------------------------------------
+//   This returns nullptr if the running sums cannot be used, in which case
+//   the caller scans the data, which also reports errors if any
+{
+    // Select the entry and the group it belongs to
+    bool lx = fit_log(xcol);
+    bool ly = fit_log(ycol);
+    uint entry = stats_sums::COUNT;
+    uint group = stats_sums::LINEAR;
+    uint col = 0;
+    switch(which)
+    {
+    case RUN_N:
+        break;
+    case RUN_X:
+    case RUN_X2:
+        if (lx)
+            entry = which == RUN_X ? stats_sums::SUM_LX : stats_sums::SUM_LX2;
+        else
+            col = xcol;
+        break;
+    case RUN_Y:
+    case RUN_Y2:
+        if (ly)
+            entry = which == RUN_Y ? stats_sums::SUM_LY : stats_sums::SUM_LY2;
+        else
+            col = ycol;
+        break;
+    case RUN_XY:
+        entry = lx ? (ly ? stats_sums::SUM_LXLY : stats_sums::SUM_LXY)
+                   : (ly ? stats_sums::SUM_XLY  : stats_sums::SUM_XY);
+        group = lx || ly ? stats_sums::LOGS : stats_sums::PAIRS;
+        break;
+    }
+    if (col)
+    {
+        if (col > columns)
+            return nullptr;
+        entry = stats_sums::SUM_COLUMNS + 2 * (col - 1);
+        if (which == RUN_X2 || which == RUN_Y2)
+            entry++;
+    }
+    else if (entry != stats_sums::COUNT)
+    {
+        group = entry == stats_sums::SUM_XY ? stats_sums::PAIRS
+                                            : stats_sums::LOGS;
+    }
+    if (group != stats_sums::LINEAR)
+        if (columns < 2 || xcol > columns || ycol > columns)
+            return nullptr;
+    return running_entry(*this, entry, group);
+}
+
+
+algebraic_p StatsAccess::running_columns(bool squares) const
+// ----------------------------------------------------------------------------
+//   Return the sums or sums of squares of all columns
+// ----------------------------------------------------------------------------
+//   This mirrors `total`, which returns a value for single-column data
+{
+    uint first = stats_sums::SUM_COLUMNS + squares;
+    if (columns == 1)
+        return running_entry(*this, first, stats_sums::LINEAR);
+
+    array_g     result = array_p(array::make(object::ID_array, nullptr, 0));
+    algebraic_g x;
+    for (uint c = 0; result && c < columns; c++)
+    {
+        x = running_entry(*this, first + 2 * c, stats_sums::LINEAR);
+        result = x ? result->append(x) : nullptr;
+    }
+    return result;
+}
+
+
+algebraic_p StatsAccess::running_variance(bool population) const
+// ----------------------------------------------------------------------------
+//   Compute the variance of all columns from the running sums
+// ----------------------------------------------------------------------------
+{
+    algebraic_g s = running_columns(false);
+    algebraic_g q = running_columns(true);
+    if (!is_exact(s) || !is_exact(q))
+        return nullptr;
+
+    algebraic_g n = integer::make(rows);
+    algebraic_g d = integer::make(rows - !population);
+    if (columns == 1)
+        return (q - s * s / n) / d;
+
+    array_g     result = array_p(array::make(object::ID_array, nullptr, 0));
+    algebraic_g x, x2;
+    array::iterator si = array_p(+s)->begin();
+    for (object_p qobj : *array_p(+q))
+    {
+        x = algebraic_p(*si++);
+        x2 = algebraic_p(qobj);
+        x = (x2 - x * x / n) / d;
+        result = x ? result->append(x) : nullptr;
+        if (!result)
+            return nullptr;
+    }
+    return result;
 }
 
 
@@ -658,6 +1277,8 @@ algebraic_p StatsAccess::sum_x() const
 //   Return the sum of values in the X column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p s = running_sum(RUN_X))
+        return s;
     return sum(sum1, xcol);
 }
 
@@ -667,6 +1288,8 @@ algebraic_p StatsAccess::sum_y() const
 //   Return the sum of values in the Y column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p s = running_sum(RUN_Y))
+        return s;
     return sum(sum1, ycol);
 }
 
@@ -676,6 +1299,8 @@ algebraic_p StatsAccess::sum_xy() const
 //   Return the sum of product of values in X and Y column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p s = running_sum(RUN_XY))
+        return s;
     return sum(sumxy, xcol, ycol);
 }
 
@@ -685,6 +1310,8 @@ algebraic_p StatsAccess::sum_x2() const
 //   Return the sum of squares of values in the X column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p s = running_sum(RUN_X2))
+        return s;
     return sum(sum2, xcol);
 }
 
@@ -694,6 +1321,8 @@ algebraic_p StatsAccess::sum_y2() const
 //   Return the sum of squares of values in the Y column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p s = running_sum(RUN_Y2))
+        return s;
     return sum(sum2, ycol);
 }
 
@@ -839,6 +1468,8 @@ algebraic_p StatsAccess::total() const
 //  Perform a sum of the columns
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p s = running_columns(false))
+        return s;
     return total(sum1);
 }
 
@@ -901,6 +1532,8 @@ algebraic_p StatsAccess::variance() const
         rt.insufficient_stats_data_error();
         return nullptr;
     }
+    if (algebraic_p var = running_variance(false))
+        return var;
     if (algebraic_g mean = average())
     {
         algebraic_g sum = total(do_variance, mean);
@@ -936,8 +1569,22 @@ algebraic_p StatsAccess::correlation() const
     }
 
     algebraic_g n     = integer::make(rows);
-    algebraic_g avg_x = sum_x() / n;
-    algebraic_g avg_y = sum_y() / n;
+    algebraic_g sx    = sum_x();
+    algebraic_g sy    = sum_y();
+    algebraic_g sxy   = running_sum(RUN_XY);
+    algebraic_g sx2   = sxy ? running_sum(RUN_X2) : nullptr;
+    algebraic_g sy2   = sxy ? running_sum(RUN_Y2) : nullptr;
+    if (is_exact(sx) && is_exact(sy) &&
+        is_exact(sxy) && is_exact(sx2) && is_exact(sy2))
+    {
+        sxy = sxy - sx * sy / n;
+        sx2 = sx2 - sx * sx / n;
+        sy2 = sy2 - sy * sy / n;
+        return sxy / sqrt::evaluate(sx2 * sy2);
+    }
+
+    algebraic_g avg_x = sx / n;
+    algebraic_g avg_y = sy / n;
     algebraic_g num   = integer::make(0);
     algebraic_g den_x = num;
     algebraic_g den_y = num;
@@ -994,8 +1641,18 @@ algebraic_p StatsAccess::covariance(bool population) const
         return nullptr;
     }
     algebraic_g n     = integer::make(rows);
-    algebraic_g avg_x = sum_x() / n;
-    algebraic_g avg_y = sum_y() / n;
+    algebraic_g sx    = sum_x();
+    algebraic_g sy    = sum_y();
+    algebraic_g sxy   = running_sum(RUN_XY);
+    if (is_exact(sx) && is_exact(sy) && is_exact(sxy))
+    {
+        sxy = sxy - sx * sy / n;
+        n = integer::make(rows - !population);
+        return sxy / n;
+    }
+
+    algebraic_g avg_x = sx / n;
+    algebraic_g avg_y = sy / n;
     algebraic_g num   = integer::make(0);
     algebraic_g x, y;
 
@@ -1074,6 +1731,8 @@ algebraic_p StatsAccess::population_variance() const
         rt.insufficient_stats_data_error();
         return nullptr;
     }
+    if (algebraic_p var = running_variance(true))
+        return var;
     if (algebraic_g mean = average())
     {
         algebraic_g sum = total(do_popvar, mean);
@@ -1117,6 +1776,419 @@ object::result StatsAccess::evaluate(eval_fn op, bool two_columns)
 
 
 
+// ============================================================================
+//
+//   Order statistics
+//
+// ============================================================================
+//   Median and quantiles select values in a compact array of samples in the
+//   C heap, holding a double approximation of each value to order them
+//   quickly. Values too close for the approximation to decide are compared
+//   exactly. All the ranks needed for the requested quantiles are found in
+//   a single introselect pass, which only partitions ranges containing a
+//   wanted rank, so that the data is never fully sorted.
+//   Exact comparisons may allocate memory and collect garbage, so samples
+//   record the offset of values in ΣData rather than pointers, and if the
+//   C heap is short, as on the DM42, the samples live in the scratchpad.
+
+struct sample
+// ----------------------------------------------------------------------------
+//   A value from ΣData with an approximation for fast comparisons
+// ----------------------------------------------------------------------------
+{
+    double      key;            // Approximate value, NaN if unknown
+    size_t      offset;         // Offset of the value in ΣData
+};
+typedef gcm<sample> sample_g;
+
+
+static inline sample &sample_at(sample_g &s, size_t i)
+// ----------------------------------------------------------------------------
+//   Access a sample, reading the possibly moved array pointer each time
+// ----------------------------------------------------------------------------
+{
+    return ((sample *) +s)[i];
+}
+
+
+static double sample_key(object_p obj)
+// ----------------------------------------------------------------------------
+//   Compute an approximate value without allocating memory
+// ----------------------------------------------------------------------------
+{
+    object::id ty = obj->type();
+    byte_p     p  = obj->payload();
+    double     v  = NAN;
+    switch(ty)
+    {
+    case object::ID_integer:
+    case object::ID_neg_integer:
+        v = double(leb128<ularge>(p));
+        break;
+    case object::ID_fraction:
+    case object::ID_neg_fraction:
+    {
+        double n = double(leb128<ularge>(p));
+        double d = double(leb128<ularge>(p));
+        v = n / d;
+        break;
+    }
+    case object::ID_decimal:
+    case object::ID_neg_decimal:
+    {
+        decimal::info di = decimal_p(obj)->shape();
+        double        scale = 1.0;
+        v = 0.0;
+        for (size_t i = 0; i < di.nkigits && i < 6; i++)
+        {
+            scale /= 1000.0;
+            v += decimal::kigit(di.base, i) * scale;
+        }
+        if (di.exponent > 300)
+            v = v ? INFINITY : 0.0;
+        else if (di.exponent < -300)
+            v = 0.0;
+        else
+            v *= pow(10.0, double(di.exponent));
+        break;
+    }
+    default:
+        return NAN;
+    }
+    return ty == object::ID_neg_integer ||
+           ty == object::ID_neg_fraction ||
+           ty == object::ID_neg_decimal ? -v : v;
+}
+
+
+static int sample_compare(sample a, sample b, array_r data)
+// ----------------------------------------------------------------------------
+//   Compare two samples, using exact comparison if keys are too close
+// ----------------------------------------------------------------------------
+//   Samples are passed by value, since comparing may move the samples
+{
+    double ka = a.key;
+    double kb = b.key;
+    if (ka == ka && kb == kb)           // Not NaN
+    {
+        double ma = ka < 0 ? -ka : ka;
+        double mb = kb < 0 ? -kb : kb;
+        double margin = 1e-9 * (ma > mb ? ma : mb);
+        if (ka + margin < kb)
+            return -1;
+        if (kb + margin < ka)
+            return 1;
+    }
+
+    int         cmp = 0;
+    algebraic_g x   = algebraic_p(byte_p(+data) + a.offset);
+    algebraic_g y   = algebraic_p(byte_p(+data) + b.offset);
+    comparison::compare(&cmp, x, y);
+    return cmp;
+}
+
+
+static void sample_sift(sample_g &s, size_t lo, size_t root, size_t end,
+                        array_r data)
+// ----------------------------------------------------------------------------
+//   Sift a sample down a heap stored at lo
+// ----------------------------------------------------------------------------
+//   Samples are always indexed through s, which is adjusted by the GC
+{
+    for (size_t child = 2 * root + 1; child < end; child = 2 * root + 1)
+    {
+        sample left = sample_at(s, lo + child);
+        if (child + 1 < end)
+        {
+            sample right = sample_at(s, lo + child + 1);
+            if (sample_compare(left, right, data) < 0)
+                child++;
+        }
+        sample top = sample_at(s, lo + root);
+        if (sample_compare(top, sample_at(s, lo + child), data) >= 0)
+            break;
+        std::swap(sample_at(s, lo + root), sample_at(s, lo + child));
+        root = child;
+    }
+}
+
+
+static void sample_sort(sample_g &s, size_t lo, size_t hi, array_r data)
+// ----------------------------------------------------------------------------
+//   Sort a range of samples with a heap sort
+// ----------------------------------------------------------------------------
+{
+    size_t n = hi - lo;
+    for (size_t k = n / 2; k--; )
+        sample_sift(s, lo, k, n, data);
+    for (size_t k = n; k-- > 1; )
+    {
+        std::swap(sample_at(s, lo), sample_at(s, lo + k));
+        sample_sift(s, lo, 0, k, data);
+    }
+}
+
+
+static void sample_select(sample_g &s, size_t lo, size_t hi,
+                          const size_t *ranks, size_t nranks, uint depth,
+                          array_r data)
+// ----------------------------------------------------------------------------
+//   Place samples at the given sorted ranks as if the range was sorted
+// ----------------------------------------------------------------------------
+//   This is a multi-rank quickselect with median-of-three pivots that
+//   falls back to sorting the range when partitioning does not converge
+{
+    while (nranks && hi - lo > 1)
+    {
+        if (hi - lo <= 8 || !depth--)
+        {
+            sample_sort(s, lo, hi, data);
+            return;
+        }
+
+        // Median of three pivot
+        size_t mid = lo + (hi - lo) / 2;
+        if (sample_compare(sample_at(s, mid), sample_at(s, lo), data) < 0)
+            std::swap(sample_at(s, mid), sample_at(s, lo));
+        if (sample_compare(sample_at(s, hi - 1), sample_at(s, lo), data) < 0)
+            std::swap(sample_at(s, hi - 1), sample_at(s, lo));
+        if (sample_compare(sample_at(s, hi - 1), sample_at(s, mid), data) < 0)
+            std::swap(sample_at(s, hi - 1), sample_at(s, mid));
+        sample pivot = sample_at(s, mid);
+
+        // Three-way partition: [lo,lt) < pivot, [lt,gt) == pivot, rest >
+        size_t lt = lo, i = lo, gt = hi;
+        while (i < gt)
+        {
+            int cmp = sample_compare(sample_at(s, i), pivot, data);
+            if (cmp < 0)
+                std::swap(sample_at(s, lt++), sample_at(s, i++));
+            else if (cmp > 0)
+                std::swap(sample_at(s, i), sample_at(s, --gt));
+            else
+                i++;
+        }
+
+        // Split the ranks between the two sides, skip those equal to pivot
+        size_t below = 0;
+        while (below < nranks && ranks[below] < lt)
+            below++;
+        size_t above = below;
+        while (above < nranks && ranks[above] < gt)
+            above++;
+        if (below)
+            sample_select(s, lo, lt, ranks, below, depth, data);
+        ranks += above;
+        nranks -= above;
+        lo = gt;
+    }
+}
+
+
+object_p StatsAccess::quantiles(object_r probabilities) const
+// ----------------------------------------------------------------------------
+//   Compute the quantiles for a probability or a list of probabilities
+// ----------------------------------------------------------------------------
+//   Quantiles interpolate linearly between closest ranks, so that the
+//   median of an even number of values is the mean of the middle two.
+//   For each probability, the result is a value for single-column data,
+//   and a vector with one value per column otherwise.
+{
+    if (!rows)
+    {
+        rt.insufficient_stats_data_error();
+        return nullptr;
+    }
+
+    object::id pty = probabilities->type();
+    bool       many = pty == object::ID_list || pty == object::ID_array;
+    list_g     plist = many ? list_p(+probabilities) : nullptr;
+    object_g   one   = +probabilities;
+    size_t   np    = plist ? plist->items() : 1;
+    if (!np)
+    {
+        rt.value_error();
+        return nullptr;
+    }
+
+    // Wanted ranks, at most two per probability
+    scribble scratch;
+    size_t   n      = rows;
+    size_t   ssize  = n * sizeof(sample);
+    size_t   rsize  = 2 * np * sizeof(size_t);
+    size_t  *ranks  = (size_t *) malloc(rsize);
+    sample  *heap   = (sample *) malloc(ssize);
+    sample_g samples = heap;
+    size_t   nranks = 0;
+    size_t   depth  = rt.depth();
+    if (!ranks || !heap)
+    {
+        // Short on C heap, use the scratchpad instead
+        free(ranks);
+        free(heap);
+        heap = nullptr;
+        ranks = nullptr;
+        byte *area = rt.allocate(ssize);
+        if (!area)
+        {
+            rt.out_of_memory_error();
+            return nullptr;
+        }
+        samples = (sample *) area;
+        ranks = (size_t *) malloc(rsize);
+        if (!ranks)
+        {
+            rt.out_of_memory_error();
+            return nullptr;
+        }
+    }
+
+    algebraic_g nm1 = integer::make(n - 1);
+    algebraic_g p, h, f, x, y;
+    for (uint pass = 0; pass < 2; pass++)
+    {
+        for (size_t c = 0; c < (pass ? columns : 1); c++)
+        {
+            // Extract the values of the column
+            if (pass)
+            {
+                size_t i = 0;
+                for (object_p row : *data)
+                {
+                    object_p item = row;
+                    if (array_p ra = row->as<array>())
+                        item = ra->at(c);
+                    if (!item || !item->is_real())
+                    {
+                        rt.type_error();
+                        goto err;
+                    }
+                    sample &si = sample_at(samples, i);
+                    si.key = sample_key(item);
+                    si.offset = byte_p(item) - byte_p(+data);
+                    i++;
+                }
+                uint limit = 2;
+                for (size_t sz = n; sz; sz /= 2)
+                    limit += 2;
+                sample_select(samples, 0, n, ranks, nranks, limit, data);
+                if (rt.error())
+                    goto err;
+            }
+
+            // Compute rank and interpolation factor for each probability
+            for (size_t pi = 0; pi < np; pi++)
+            {
+                object_p pobj = plist ? plist->at(pi) : +one;
+                if (!pobj || !pobj->is_real())
+                {
+                    rt.type_error();
+                    goto err;
+                }
+                p = algebraic_p(pobj);
+                if (p->is_negative(false))
+                {
+                    rt.domain_error();
+                    goto err;
+                }
+                h = nm1 * p;
+                f = h ? floor::evaluate(h) : nullptr;
+                if (!f)
+                    goto err;
+                size_t k = f->as_uint32(0, true);
+                if (rt.error() || k >= n)
+                {
+                    rt.domain_error();
+                    goto err;
+                }
+                h = h - f;
+                if (!h)
+                    goto err;
+                bool next = !h->is_zero(false);
+
+                if (!pass)
+                {
+                    ranks[nranks++] = k;
+                    if (next)
+                        ranks[nranks++] = k + 1;
+                    continue;
+                }
+
+                // Interpolate between the two closest ranks
+                size_t offset = sample_at(samples, k).offset;
+                x = algebraic_p(byte_p(+data) + offset);
+                if (next)
+                {
+                    offset = sample_at(samples, k + 1).offset;
+                    y = algebraic_p(byte_p(+data) + offset);
+                    x = x + h * (y - x);
+                }
+                if (!x || !rt.push(+x))
+                    goto err;
+            }
+        }
+
+        if (!pass)
+        {
+            // Sort and deduplicate the ranks
+            for (size_t i = 1; i < nranks; i++)
+                for (size_t j = i; j > 0 && ranks[j - 1] > ranks[j]; j--)
+                    std::swap(ranks[j - 1], ranks[j]);
+            size_t unique = 0;
+            for (size_t i = 0; i < nranks; i++)
+                if (!unique || ranks[unique - 1] != ranks[i])
+                    ranks[unique++] = ranks[i];
+            nranks = unique;
+        }
+    }
+    free(ranks);
+    free(heap);
+    ranks = nullptr;
+    heap = nullptr;
+
+    // Build the results from the stack, which holds np values per column
+    {
+        scribble scr;
+        object_g result;
+        for (size_t pi = 0; pi < np; pi++)
+        {
+            if (columns == 1)
+            {
+                result = rt.stack(np - 1 - pi);
+            }
+            else
+            {
+                scribble sr;
+                for (size_t c = 0; c < columns; c++)
+                {
+                    object_p value = rt.stack(np * (columns - c) - 1 - pi);
+                    if (!value || !rt.append(value->size(), byte_p(value)))
+                        goto err;
+                }
+                result = list::make(object::ID_array,
+                                    sr.scratch(), sr.growth());
+            }
+            if (!plist)
+            {
+                rt.drop(rt.depth() - depth);
+                return result;
+            }
+            if (!result || !rt.append(result->size(), byte_p(+result)))
+                goto err;
+        }
+        rt.drop(rt.depth() - depth);
+        return list::make(plist->type(), scr.scratch(), scr.growth());
+    }
+
+err:
+    free(ranks);
+    free(heap);
+    rt.drop(rt.depth() - depth);
+    return nullptr;
+}
+
+
+
 // ============================================================================
 //
 //   User-level data analysis commands
@@ -1155,8 +2227,100 @@ COMMAND_BODY(Median)
 //  Find the median of the input data
 // ----------------------------------------------------------------------------
 {
-    rt.unimplemented_error();
-    return ERROR;
+    StatsAccess stats;
+    if (!stats)
+        return ERROR;
+    object_g half = +fraction::make(integer::make(1), integer::make(2));
+    object_g median = half ? stats.quantiles(half) : nullptr;
+    return median && rt.push(median) ? OK : ERROR;
+}
+
+
+static object::result quantiles(object_p probabilities, bool percent)
+// ----------------------------------------------------------------------------
+//   Compute quantiles or percentiles for the given probabilities
+// ----------------------------------------------------------------------------
+{
+    StatsAccess stats;
+    if (!stats)
+        return object::ERROR;
+
+    object_g probs = probabilities;
+    if (percent)
+    {
+        algebraic_g hundred = integer::make(100);
+        object::id  pty = probs->type();
+        if (pty == object::ID_list || pty == object::ID_array)
+        {
+            scribble scr;
+            algebraic_g p;
+            for (object_p pobj : *list_p(+probs))
+            {
+                if (!pobj->is_real())
+                {
+                    rt.type_error();
+                    return object::ERROR;
+                }
+                p = algebraic_p(pobj);
+                p = p / hundred;
+                if (!p || !rt.append(p->size(), byte_p(+p)))
+                    return object::ERROR;
+            }
+            probs = list::make(pty, scr.scratch(), scr.growth());
+        }
+        else if (probs->is_real())
+        {
+            algebraic_g p = algebraic_p(+probs);
+            probs = +(p / hundred);
+        }
+        if (!probs)
+            return object::ERROR;
+    }
+
+    object_g result = stats.quantiles(probs);
+    if (!result || !rt.drop() || !rt.push(result))
+        return object::ERROR;
+    return object::OK;
+}
+
+
+COMMAND_BODY(Quantile)
+// ----------------------------------------------------------------------------
+//   Compute quantiles for a probability or list of probabilities
+// ----------------------------------------------------------------------------
+{
+    if (!rt.args(1))
+        return ERROR;
+    return quantiles(rt.top(), false);
+}
+
+
+COMMAND_BODY(Percentile)
+// ----------------------------------------------------------------------------
+//   Compute percentiles for a percentage or list of percentages
+// ----------------------------------------------------------------------------
+{
+    if (!rt.args(1))
+        return ERROR;
+    return quantiles(rt.top(), true);
+}
+
+
+COMMAND_BODY(Quartiles)
+// ----------------------------------------------------------------------------
+//   Compute the first, second and third quartiles, i.e. 25%, 50% and 75%
+// ----------------------------------------------------------------------------
+{
+    StatsAccess stats;
+    if (!stats)
+        return ERROR;
+    integer_g   four = integer::make(4);
+    algebraic_g q1   = +fraction::make(integer::make(1), four);
+    algebraic_g q2   = +fraction::make(integer::make(2), four);
+    algebraic_g q3   = +fraction::make(integer::make(3), four);
+    object_g    qs   = list::make(q1, q2, q3);
+    object_g    result = qs ? stats.quantiles(qs) : nullptr;
+    return result && rt.push(result) ? OK : ERROR;
 }
 
 
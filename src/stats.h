@@ -93,6 +93,9 @@ struct StatsData : command
 
         operator bool() const   { return data; }
     };
+
+    static void sums_invalidate();
+    static void sums_moved(object_p to, object_p from, object_p last);
 };
 
 
@@ -111,6 +114,13 @@ struct StatsAccess : StatsParameters::Access, StatsData::Access
     algebraic_p         sum(sum_fn op, uint xcol) const;
     algebraic_p         sum(sxy_fn op, uint xcol, uint ycol) const;
     algebraic_p         fit_transform(algebraic_r x, uint scol) const;
+    bool                fit_log(uint col) const;
+
+    enum running { RUN_N, RUN_X, RUN_Y, RUN_X2, RUN_Y2, RUN_XY };
+    algebraic_p         running_sum(running which) const;
+    algebraic_p         running_columns(bool squares) const;
+    algebraic_p         running_variance(bool population) const;
+    object_p            quantiles(object_r probabilities) const;
 
     algebraic_p         num_rows() const;
     algebraic_p         sum_x() const;
@@ -166,6 +176,9 @@ COMMAND_DECLARE(ClearData);
 COMMAND_DECLARE(DataSize);
 COMMAND_DECLARE(Average);
 COMMAND_DECLARE(Median);
+COMMAND_DECLARE(Quartiles);
+COMMAND_DECLARE(Quantile);
+COMMAND_DECLARE(Percentile);
 COMMAND_DECLARE(MinData);
 COMMAND_DECLARE(MaxData);
 COMMAND_DECLARE(SumOfX);
@@ -30,14 +30,17 @@
 #include "tests.h"
 
 #include "dmcp.h"
+#include "files.h"
 #include "recorder.h"
 #include "settings.h"
 #include "stack.h"
+#include "sysmenu.h"
 #include "types.h"
 #include "user_interface.h"
 
 #include <regex.h>
 #include <stdio.h>
+#include <sys/stat.h>
 
 extern bool run_tests;
 extern volatile int lcd_needsupdate;
@@ -113,6 +116,7 @@ EXTRA(plotfns,          "Plot all functions");
 EXTRA(flags,            "Enable/disable every RPL flag");
 EXTRA(settings,         "Recall and activate every RPL setting");
 EXTRA(commands,         "Parse every single RPL command");
+EXTRA(bench,            "Standard benchmark suite with memory statistics");
 
 
 void tests::run(bool onlyCurrent)
@@ -180,6 +184,7 @@ void tests::run(bool onlyCurrent)
         graphic_commands();
         online_help();
         regression_checks();
+        benchmarks();
     }
     summary();
 
@@ -637,6 +642,16 @@ void tests::editor_operations()
         .test(CLEAR, "ABCD").editor("ABCD")
         .test(EXIT).editor("").noerr()
         .test(XSHIFT, UP).editor("ABCD");
+    step("Multi-line editing")
+        .test(CLEAR, "AA\nAAA\nA").editor("AA\nAAA\nA")
+        .test(SHIFT, UP, "X").editor("AA\nAXAA\nA")
+        .test(BSP).editor("AA\nAAA\nA")
+        .test(SHIFT, UP, "Y").editor("AYA\nAAA\nA");
+    step("Inserting and removing lines")
+        .test("\n").editor("AY\nA\nAAA\nA")
+        .test(SHIFT, DOWN, "Z").editor("AY\nA\nZAAA\nA")
+        .test(BSP, BSP).editor("AY\nAAAA\nA")
+        .test(SHIFT, DOWN, SHIFT, DOWN, "B").editor("AY\nAAAA\nAB");
     step("End of editor")
         .test(CLEAR);
 }
@@ -787,6 +802,16 @@ void tests::arithmetic()
     test(1, ADD).type(object::ID_neg_integer).expect("-1");
     test(1, ADD).type(object::ID_integer).expect("0");
 
+    step("Preallocated small integer range");
+    test(CLEAR, "-128 1 -", ENTER).type(object::ID_neg_integer).expect("-129");
+    test(1, ADD).type(object::ID_neg_integer).expect("-128");
+    test(CLEAR, "1023 1 +", ENTER).type(object::ID_integer).expect("1 024");
+    test(1, SUB).type(object::ID_integer).expect("1 023");
+    test(CLEAR, "0.5 2 *", ENTER).type(object::ID_decimal).expect("1.");
+    test(CLEAR, "'X' 1023 STO 'X' 1 STO+ X", ENTER)
+        .type(object::ID_integer).expect("1 024");
+    test(CLEAR, "'X' PURGE", ENTER).noerr();
+
     step("Integer addition overflow");
     test(CLEAR, (1ULL << 63) - 2ULL, ENTER, 1, ADD)
         .type(object::ID_integer)
@@ -1001,6 +1026,33 @@ void tests::global_variables()
     test(CLEAR, "'StatsData' RCL", ENTER).expect("[ 1 2 3 ]");
     test(CLEAR, "'ΣData' PURGE", ENTER).noerr();
 
+    step("Statistics sums follow data updates");
+    test(CLEAR, "ClΣ [1 2] Σ+ [3 5] Σ+ [4 7] Σ+ ΣX", ENTER).expect("8");
+    test(CLEAR, "[2 3] Σ+ ΣXY", ENTER).expect("51");
+    test(CLEAR, "Σ- DROP ΣXY", ENTER).expect("45");
+    test(CLEAR, "Total", ENTER).expect("[ 8 14 ]");
+    test(CLEAR, "Variance", ENTER).expect("[ ⁷/₃ ¹⁹/₃ ]");
+    test(CLEAR, "ClΣ 1.5 Σ+ 1E30 Σ+ Σ- DROP ΣX", ENTER).expect("1.5");
+    test(CLEAR, "ClΣ 1000000000000000000001. Σ+ "
+         "1000000000000000000002. Σ+ 1000000000000000000003. Σ+ "
+         "Variance", ENTER).expect("1.");
+    test(CLEAR, "ClΣ [1 2] Σ+ [3 5] Σ+ [4 7] Σ+ 1 'SV' STO ΣXY", ENTER)
+        .expect("45");
+    test(CLEAR, "\"Longer value\" 'SV' STO [2 3] Σ+ ΣXY", ENTER).expect("51");
+    test(CLEAR, "'SV' PURGE Σ- DROP ΣXY", ENTER).expect("45");
+    test(CLEAR, "ClΣ [1 2] Σ+ [3 5] Σ+ [4 7] Σ+", ENTER).noerr();
+
+    step("Median and quantiles");
+    test(CLEAR, "Median", ENTER).expect("[ 3 5 ]");
+    test(CLEAR, "Quartiles", ENTER).expect("{ [ 2 ⁷/₂ ] [ 3 5 ] [ ⁷/₂ 6 ] }");
+    test(CLEAR, "50 Percentile", ENTER).expect("[ 3 5 ]");
+    test(CLEAR, "{ 0 1 } Quantile", ENTER).expect("{ [ 1 2 ] [ 4 7 ] }");
+    test(CLEAR, "2 Quantile", ENTER).error("Argument outside domain");
+    test(CLEAR, "ClΣ 1 100 FOR i i 37 * 101 MOD Σ+ NEXT Median", ENTER)
+        .expect("¹⁰¹/₂");
+    test(CLEAR, "0.9 Quantile", ENTER).expect("90.1");
+    test(CLEAR, "'ΣData' PURGE 'ΣParameters' PURGE", ENTER).noerr();
+
     step("Store and recall to StatsParameters");
     test(CLEAR, "{0} 'ΣParameters' STO", ENTER).noerr();
     test(CLEAR, "'ΣPar' RCL", ENTER).expect("{ 0 }");
@@ -1085,6 +1137,24 @@ void tests::global_variables()
     step("Two independent variables with the same name")
         .test(CLEAR, "DirTest2 Foo", ENTER).expect("\"Hello\"");
 
+    step("Populate large directory")
+        .test(CLEAR,
+              "« 1 40 for i i sq \"'V\" i →Str + \"'\" + Str→ sto next »"
+              " eval", ENTER).noerr();
+    step("Recall from large directory")
+        .test(CLEAR, "V17", ENTER).expect("289");
+    step("Recall is case insensitive in large directory")
+        .test(CLEAR, "'v30' RCL", ENTER).expect("900");
+    step("Replace value in large directory")
+        .test(CLEAR, "\"Longer value\" 'V17' STO V17 V18", ENTER)
+        .expect("324");
+    step("Purge from large directory")
+        .test(CLEAR, "'V5' purge V6", ENTER).expect("36");
+    step("Purged variable is gone from large directory")
+        .test(CLEAR, "'V5' RCL", ENTER).error("Undefined name").clear();
+    step("Recall from large directory after purge")
+        .test(CLEAR, "V40 V17", ENTER).expect("\"Longer value\"");
+
     step("Save to file as text")
         .test(CLEAR, "1.42 \"Hello.txt\"", NOSHIFT, G).noerr();
     step("Restore from file as text")
@@ -1097,6 +1167,57 @@ void tests::global_variables()
         .test(CLEAR, "1.42 \"Hello.48b\"", NOSHIFT, G).noerr();
     step("Restore from file as text")
         .test(CLEAR, "\"Hello.48b\" RCL", ENTER).noerr().expect("1.42");
+    step("Save large text to file")
+        .test(CLEAR, "\"\" 1 1000 START \"x\" + NEXT \"Big.txt\" STO",
+              ENTER).noerr();
+    step("Restore large text using few filesystem calls")
+        .test(CLEAR, "FileSystemCalls \"Big.txt\" RCL SIZE "
+              "FileSystemCalls ROT - 20 <", ENTER)
+        .noerr().expect("True")
+        .test(BSP).expect("1 000");
+    step("Purge large text file")
+        .test(CLEAR, "\"Big.txt\" PURGE", ENTER).noerr();
+
+    step("Save state with a binary snapshot")
+        .test(CLEAR, "42 'SnapVar' STO 7 8", ENTER).noerr();
+    char previous[256];
+    strncpy(previous, get_reset_state_file(), sizeof(previous) - 1);
+    previous[sizeof(previous) - 1] = 0;
+    check(save_state_file("state/Snapshot.48S"), "Saving state failed");
+    set_reset_state_file(previous);
+    check(load_state_snapshot("state/Snapshot.48S"), "Snapshot not loaded");
+    step("Snapshot restores the stack")
+        .test("DEPTH", ENTER).expect("2");
+    step("Snapshot restores global variables")
+        .test(CLEAR, "'SnapVar' PURGE", ENTER).noerr();
+    check(load_state_snapshot("state/Snapshot.48S"), "Snapshot not reloaded");
+    test(CLEAR, "SnapVar", ENTER).expect("42");
+    step("Snapshot is stale when the state changes with the same size");
+    if (FILE *state = fopen("state/Snapshot.48S", "r+"))
+    {
+        fputc('#', state);
+        fclose(state);
+    }
+    check(!load_state_snapshot("state/Snapshot.48S"), "Stale snapshot loaded");
+    remove("state/Snapshot.48S");
+    remove("state/Snapshot.48I");
+    test(CLEAR, "'SnapVar' PURGE", ENTER).noerr();
+
+    step("Reset memory statistics")
+        .test(CLEAR, "ResetMemoryStatistics MemoryStatistics 4 GET", ENTER)
+        .expect("0");
+    step("Memory statistics count allocations")
+        .test(CLEAR, "ResetMemoryStatistics 1 100 FOR i i →Text DROP NEXT "
+              "MemoryStatistics DUP 1 GET 0 > SWAP 6 GET SIZE 0 > AND", ENTER)
+        .expect("True");
+    step("Memory statistics name evaluated objects as text")
+        .test(CLEAR, "« 1 2 + →Text » 'MemProg' STO ResetMemoryStatistics "
+              "1 10 START MemProg DROP NEXT "
+              "MemoryStatistics 6 GET 1 GET 1 GET TypeName", ENTER)
+        .expect("\"text\"")
+        .test(CLEAR, "MemoryStatistics 6 GET →Text \"symbol\" POS 0 >", ENTER)
+        .expect("True")
+        .test(CLEAR, "'MemProg' PURGE", ENTER).noerr();
 }
 
 
@@ -1200,6 +1321,54 @@ void tests::for_loops()
     pgmo = "« 'X' 10 1 for i i x² + next »";
     test(CLEAR, pgm, ENTER).noerr().type(object::ID_program).want(pgmo);
     test(RUNSTOP).noerr().type(object::ID_expression).expect("'X+100'");
+
+    step("Nested loops");
+    test(CLEAR, "« 0 1 3 FOR i 1 3 FOR j i j * + NEXT NEXT » EVAL", ENTER)
+        .noerr().type(object::ID_integer).expect(36);
+
+    step("Counter leaving native range");
+    test(CLEAR, "« 0 134217720 134217728 FOR i i + 5 STEP » EVAL", ENTER)
+        .noerr().type(object::ID_integer).expect(268435445);
+
+    step("Switching to fractional step");
+    test(CLEAR, "« 'X' 1 3 FOR i i + 0.5 STEP » EVAL", ENTER)
+        .noerr().type(object::ID_expression).expect("'X+1+1.5+2+2.5+3'");
+
+    step("Storing into loop variable");
+    test(CLEAR, "« 0 1 3 FOR i 100 'i' STO i + NEXT » EVAL", ENTER)
+        .noerr().type(object::ID_integer).expect(300);
+
+    step("Start loop with unread counter");
+    test(CLEAR, "« 0 1 1000 START 1 + NEXT » EVAL", ENTER)
+        .noerr().type(object::ID_integer).expect(1000);
+
+    step("Small loop counters do not allocate");
+    test(CLEAR, "« ResetMemoryStatistics 1 1000 FOR i NEXT "
+         "MemoryStatistics 1 GET » EVAL", ENTER)
+        .noerr().expect(0);
+
+    step("Large loop counters do not allocate");
+    test(CLEAR, "« ResetMemoryStatistics 1 10000 FOR i NEXT "
+         "1 10000 START NEXT MemoryStatistics 1 GET » EVAL", ENTER)
+        .noerr().expect(0);
+
+    step("Reading a large loop counter");
+    test(CLEAR, "« 0 1 10000 FOR i i + NEXT » EVAL", ENTER)
+        .noerr().type(object::ID_integer).expect(50005000);
+
+    step("Reading loop counters below other locals");
+    test(CLEAR, "« 0 1 3 FOR i 10 → x « 1 2 FOR j i j * x * + NEXT » NEXT » "
+         "EVAL", ENTER)
+        .noerr().type(object::ID_integer).expect(180);
+    test(CLEAR, "« 0 1 2 FOR i 1 2 FOR j 100 'j' STO i + NEXT NEXT » EVAL",
+         ENTER)
+        .noerr().type(object::ID_integer).expect(6);
+
+    step("Error inside native loop");
+    test(CLEAR, "« 1 5 FOR i 1 i 3 - / DROP NEXT » EVAL", ENTER)
+        .error("Divide by zero");
+    test(CLEAR, "« 0 1 3 FOR i i + NEXT » EVAL", ENTER)
+        .noerr().type(object::ID_integer).expect(6);
 }
 
 
@@ -2047,6 +2216,47 @@ void tests::decimal_numerical_functions()
         .test(CLEAR, "-3.21 -1.23 atan2", ENTER)
         .expect("-1.93671 70284 36984 00445 39742 77784 19614");
 
+    step("Select 120-digit precision")
+        .test(CLEAR, "120 PRECISION", ENTER).noerr();
+    step("Check sin² + cos² = 1")
+        .test(CLEAR, "if 2.3 sin sq 2.3 cos sq + 1 - abs 1E-115 < "
+              "then PASS else FAIL end", ENTER)
+        .expect("'PASS'");
+    step("Check ln(exp(x)) = x")
+        .test(CLEAR, "if 0.77 exp ln 0.77 - abs 1E-115 < "
+              "then PASS else FAIL end", ENTER)
+        .expect("'PASS'");
+    step("Check sin(1) against reference value")
+        .test(CLEAR, "if 1. sin "
+              "0.841470984807896506652502321630298999622563060798371065672751"
+              "7099919104043912396689486397435430526958543490379079206742933"
+              " - abs 1E-115 < then PASS else FAIL end", ENTER)
+        .expect("'PASS'");
+    step("Check cos(1) against reference value")
+        .test(CLEAR, "if 1. cos "
+              "0.540302305868139717400936607442976603732310420617922227670097"
+              "2553811003947744717645179518560871830893435717311600300890979"
+              " - abs 1E-115 < then PASS else FAIL end", ENTER)
+        .expect("'PASS'");
+    step("Check exp(0.9) against reference value")
+        .test(CLEAR, "if 0.9 exp "
+              "2.45960311115694966380012656360247069542177230644008302074854"
+              "5736657466552943365860870497185275930801502314734282469001212"
+              " - abs 1E-115 < then PASS else FAIL end", ENTER)
+        .expect("'PASS'");
+    step("Check ln(3.7) against reference value")
+        .test(CLEAR, "if 3.7 ln "
+              "1.30833281965017876035010421634708295629897609853886318761158"
+              "4780225417137313008585163024328582570362439841168248609418752"
+              " - abs 1E-115 < then PASS else FAIL end", ENTER)
+        .expect("'PASS'");
+    step("Check ln(0.3) against reference value")
+        .test(CLEAR, "if 0.3 ln "
+              "1.20397280432593599262274621776183850295361093080602352429863"
+              "3567330078316458743513362381450275866209553997754976328382891"
+              " + abs 1E-115 < then PASS else FAIL end", ENTER)
+        .expect("'PASS'");
+
     step("Restore default 24-digit precision");
     test(CLEAR, "24 PRECISION 12 SIG", ENTER).noerr();
 }
@@ -2670,6 +2880,13 @@ void tests::units_and_conversions()
         .test(ADD).expect("101.54572 8 km/h");
     step("Unit parsing on command line")
         .test(CLEAR, "12_km/s^2", ENTER).expect("12 km/s↑2");
+    step("Unit table and list index share the side cache budget")
+        .test(CLEAR, "1 1000 FOR i i NEXT 1000 →List 'LL' STO "
+              "LL 500 GET 1_km 1_m Convert UnitValue 'LL' PURGE", ENTER)
+        .expect("1 000")
+        .test(BSP).expect("500")
+        .check(side_cache::allocated() <= side_cache::BUDGET,
+               "Side caches use ", side_cache::allocated(), " bytes");
 }
 
 void tests::list_functions()
@@ -2738,6 +2955,37 @@ void tests::list_functions()
     step("Applying a function to a  list");
     test(CLEAR, "{ A B C } sin", ENTER)
         .expect("{ 'sin A' 'sin B' 'sin C' }");
+
+    step("Indexed access in a large list");
+    test(CLEAR, "1 200 FOR i i NEXT 200 →List 'LL' STO", ENTER).noerr()
+        .test(CLEAR, "LL 150 GET LL 1 GET LL 200 GET", ENTER)
+        .expect("200")
+        .test(BSP).expect("1")
+        .test(BSP).expect("150")
+        .test(CLEAR, "LL 201 GET", ENTER).error("Index out of range");
+    step("In-place PUT in a large named list");
+    test(CLEAR, "LL 'LL' 150 -150 PUT LL 150 GET", ENTER).expect("-150")
+        .test(BSP, "150 GET", ENTER).expect("150");
+    step("In-place PUTI in a large named list");
+    test(CLEAR, "'LL' 200 -200 PUTI LL 200 GET", ENTER).expect("-200")
+        .test(BSP).expect("1")
+        .test(BSP).expect("'LL'");
+    step("In-place PUT keeps elements taken from a nested list");
+    test(CLEAR, "{ { 1 2 } { 3 4 } } 'NL' STO "
+         "NL 2 GET 'NL' 2 { 5 6 } PUT", ENTER).expect("{ 3 4 }")
+        .test(CLEAR, "NL 2 GET 1 GET 'NL' 2 { 7 8 } PUT", ENTER).expect("5")
+        .test(CLEAR, "NL 'NL' PURGE", ENTER).expect("{ { 1 2 } { 7 8 } }");
+    step("In-place PUT of a nested list with a different layout");
+    test(CLEAR, "1000 1 70 START 1 NEXT 71 →List 1 →List 'NL' STO "
+         "'NL' 1 GET 2 GET", ENTER).expect("1")
+        .test(CLEAR, "'NL' 1 1 1000 1 69 START 1 NEXT 71 →List PUT "
+              "'NL' 1 GET 2 GET", ENTER).expect("1 000")
+        .test(CLEAR, "'NL' 1 GET 71 GET 'NL' PURGE", ENTER).expect("1");
+    step("PUT with a different size in a large named list");
+    test(CLEAR, "'LL' 3 \"Three\" PUT LL 3 GET LL 4 GET", ENTER)
+        .expect("4")
+        .test(BSP).expect("\"Three\"")
+        .test(CLEAR, "LL SIZE 'LL' PURGE", ENTER).expect("200");
 }
 
 
@@ -3047,6 +3295,41 @@ void tests::matrix_functions()
     test(CLEAR, "[[1 2 3][4 5 6][7 8 19]] DET", ENTER)
         .want("-30");
 
+    step("Decimal matrices");
+    test(CLEAR, "[[1. 2.][3. 4.]] DET", ENTER)
+        .want("-2.");
+    test(CLEAR, "[[1. 2.][2. 4.]] DET", ENTER)
+        .want("0");
+    test(CLEAR, "[[1. 2.][3. 4.]] INV", ENTER)
+        .want("[ [ -2. 1. ] [ 1.5 -0.5 ] ]");
+    test(CLEAR, "[[1. 2.][2. 4.]] INV", ENTER)
+        .error("Divide by zero");
+    test(CLEAR, "[[1.5 2][3 4]] [[1 0][0 1]] *", ENTER)
+        .want("[ [ 1.5 2. ] [ 3. 4. ] ]");
+    test(CLEAR, "[[1.5 2][3 4]] [1 1] *", ENTER)
+        .want("[ 3.5 7. ]");
+    test(CLEAR, "[[1.5 2][3 4]] [[1 2][3 4]] /", ENTER)
+        .want("[ [ 0. 0. ] [ 0.75 1. ] ]");
+    test(CLEAR, "[[1. 1.][1. 1.0000000000000000000001]] DET", ENTER)
+        .want("1.⁳⁻²²");
+    test(CLEAR, "[[1. 1.][1. 1.0000000000000000000001]] INV", ENTER)
+        .noerr();
+
+    step("Large decimal matrices");
+    std::string large = "[";
+    for (uint r = 0; r < 20; r++)
+    {
+        large += "[";
+        for (uint c = 0; c < 20; c++)
+            large += r == c ? " 2.5" : c == r + 1 ? " 1" : " 0";
+        large += "]";
+    }
+    large += "]";
+    test(CLEAR, large.c_str(), " DUP INV * DET 1 - ABS 1E-20 <", ENTER)
+        .expect("True");
+    test(CLEAR, large.c_str(), " DET 2.5 20 ^ - ABS 1E-10 <", ENTER)
+        .expect("True");
+
     step("Froebenius norm");
     test(CLEAR, "[[1 2] [3 4]] ABS", ENTER)
         .want("5.47722 55750 5");
@@ -3075,6 +3358,28 @@ void tests::solver_testing()
     step("Solver without solution")
         .test(CLEAR, "'sq(x)+3=0' 'X' 0 ROOT", ENTER)
         .error("No solution?");
+    step("Solver reaches full precision after reduced precision passes")
+        .test(CLEAR, "if 'sq(x)=2' 'X' 1 ROOT DTAG 2 SQRT - ABS 1E-22 < "
+              "then PASS else FAIL end", ENTER)
+        .noerr().expect("'PASS'");
+
+    step("Hybrid solver with equation")
+        .test(CLEAR, "HybridSolver", ENTER).noerr()
+        .test(CLEAR, "'sq(x)=3' 'X' 0 ROOT", ENTER)
+        .noerr().expect("X:1.73205 08075 7");
+    step("Hybrid solver without solution")
+        .test(CLEAR, "'sq(x)+3=0' 'X' 0 ROOT", ENTER)
+        .error("No solution?");
+    step("Hybrid solver requires fewer iterations than secant solver")
+        .test(CLEAR, "'exp(X)=1E10' 'X' 0 ROOT DROP "
+              "SolverIterationCount "
+              "SecantSolver "
+              "'exp(X)=1E10' 'X' 0 ROOT DROP "
+              "SolverIterationCount "
+              "if < then PASS else FAIL end", ENTER)
+        .noerr().expect("'PASS'");
+    step("Restore secant solver")
+        .test(CLEAR, "SecantSolver", ENTER).noerr();
 }
 
 
@@ -3095,6 +3400,25 @@ void tests::numerical_integration_testing()
         .test("'sq(Z)+Z'", ENTER).expect("'Z²+Z'")
         .test(F, ALPHA, Z, ENTER).expect("'Z'")
         .test(SHIFT, KEY8, F2).wait(1500).expect("⁵³/₆");
+    step("Tanh-sinh integration")
+        .test(CLEAR, "TanhSinhIntegration", ENTER).noerr()
+        .test(CLEAR, "if 1 2 '1/X' 'X' INTEGRATE 2 LN - ABS 1E-12 < "
+              "then PASS else FAIL end", ENTER)
+        .noerr().expect("'PASS'");
+    step("Tanh-sinh integration with singularity at end of range")
+        .test(CLEAR, "if 0 1 'inv(sqrt(X))' 'X' INTEGRATE 2 - ABS 1E-12 < "
+              "then PASS else FAIL end", ENTER)
+        .noerr().expect("'PASS'");
+    step("Tanh-sinh integration requires fewer evaluations than Romberg")
+        .test(CLEAR, "-3 3 'exp(-sq(X))' 'X' INTEGRATE DROP "
+              "IntegrationEvaluations "
+              "RombergIntegration "
+              "-3 3 'exp(-sq(X))' 'X' INTEGRATE DROP "
+              "IntegrationEvaluations "
+              "if < then PASS else FAIL end", ENTER)
+        .noerr().expect("'PASS'");
+    step("Restore Romberg integration")
+        .test(CLEAR, "RombergIntegration", ENTER).noerr();
 }
 
 
@@ -3740,6 +4064,13 @@ void tests::plotting()
     step("Function plot: Disable curve filling with flag -31");
     test(CLEAR, XSHIFT, UP, ENTER, "-31 CF", ENTER,
          XSHIFT, O, F1).wait(200).image("plot-pgm").noerr();
+    step("Function plot: Adaptive sampling")
+        .test(CLEAR, "AdaptivePlotSampling '3*sin(x)' FunctionPlot", ENTER)
+        .noerr().wait(200)
+        .test(CLEAR, "FullPlotSampling", ENTER).noerr();
+    step("Function plot: Redraw from plot cache")
+        .test(CLEAR, "'3*sin(x)' FunctionPlot", ENTER).noerr()
+        .wait(200).image("plot-sine");
 
     step("Polar plot: Program");
     test(CLEAR, SHIFT, RUNSTOP,
@@ -4113,6 +4444,193 @@ void tests::graphic_commands()
 
 
 
+void tests::benchmarks()
+// ----------------------------------------------------------------------------
+//   Run the standard benchmark suite, reporting one JSON line per benchmark
+// ----------------------------------------------------------------------------
+//   Each benchmark leaves either nothing or a single result to check.
+//   Timing and memory statistics are written to stdout, so that running
+//   `db48x -Tbench > bench.json` gives results that can be compared
+//   between commits. The `stack` code fills the stack before the benchmark
+//   and is not measured. The `cleanup` code restores settings or purges
+//   variables once the benchmark is done.
+{
+    BEGIN(bench);
+
+    // Save inline code examples from the help file, compiled by "parse"
+    const uint  max_examples = 200;
+    std::string source       = "{";
+    uint        examples     = 0;
+    if (FILE *help = fopen(HELPFILE_NAME, "r"))
+    {
+        std::string example;
+        bool        code     = false;
+        int         c;
+        while (examples < max_examples && (c = fgetc(help)) != EOF)
+        {
+            if (c == '`')
+            {
+                if (code && example.size() && example.find_first_of("\"`\n")
+                    == std::string::npos)
+                {
+                    source += "\n\"« " + example + " »\"";
+                    examples++;
+                }
+                example.clear();
+                code = !code;
+            }
+            else if (code)
+            {
+                example += char(c);
+            }
+        }
+        fclose(help);
+    }
+    source += "\n}\n";
+
+    step("Extract code examples from help file")
+        .check(examples > 0, "No code example found in ", HELPFILE_NAME);
+    mkdir("data", 0777);
+    if (FILE *bench = fopen("data/ParseBench.48s", "w"))
+    {
+        fwrite(source.data(), 1, source.size(), bench);
+        fclose(bench);
+    }
+
+    static struct
+    {
+        cstring name;
+        cstring setup;
+        cstring code;
+        cstring result;
+        bool    graphics;
+        cstring stack;
+        cstring cleanup;
+    } suite[] =
+    {
+        { "nqueens", nullptr,
+          "0 "
+          "DO 8 SWAP 1 + "
+          "WHILE DUP2 DO 1 - UNTIL DUP2 5 + PICK - ABS DUP2 - * NOT END "
+          "REPEAT DROP WHILE SWAP DUP 1 SAME REPEAT - END 1 - SWAP END "
+          "DROP UNTIL DUP 8 SAME END →List",
+          "{ 8 4 1 3 6 2 7 5 }", false },
+        { "cbench",
+          "« IF DUP 1 ≠ THEN IF DUP 2 MOD THEN 3 * 1 + ELSE 2 / END "
+          "Collatz END » 'Collatz' STO",
+          "989345275647 Collatz",
+          "1", false, nullptr,
+          "'Collatz' PURGE" },
+        { "sumtest", "RAD",
+          "0 1 100 FOR x x tan⁻¹ sin exp ∛ + NEXT DROP",
+          nullptr, false },
+        { "factorial", nullptr,
+          "200 FACT 199 FACT /",
+          "200", false },
+        { "power2", "16384 MaxNumberBits",
+          "2 10000 ^ 2 9990 ^ /",
+          "1 024", false, nullptr,
+          "4096 MaxNumberBits" },
+        { "inverse", nullptr,
+          "[[1 1 1 1 1][1 2 3 4 5][1 3 6 10 15][1 4 10 20 35][1 5 15 35 70]]"
+          " → M « 1 10 START M INV DROP NEXT M INV DET »",
+          "1", false },
+        { "sincos120", "RAD 120 PRECISION",
+          "1 20 FOR i i 0.37 * DUP SIN SWAP COS DROP2 NEXT",
+          nullptr, false },
+        { "exp120", nullptr,
+          "1 20 FOR i i 0.37 * EXP DROP NEXT",
+          nullptr, false },
+        { "ln120", nullptr,
+          "1 20 FOR i i 0.37 * LN DROP NEXT",
+          nullptr, false, nullptr,
+          "24 PRECISION" },
+        { "expand", nullptr,
+          "'(A+B)^3' EXPAND DROP",
+          nullptr, false },
+        { "simplify", nullptr,
+          "'(X^2)*(X^3)*1+0*Y+(Z^2)*(Z^4)*1' SIMPLIFY DROP",
+          nullptr, false },
+        { "rewrite", nullptr,
+          "'(A+B)^3' EXPAND COLLECT SIMPLIFY DROP",
+          nullptr, false },
+        // The collected form is checked in expand_collect_simplify, so the
+        // benchmark checks that rewriting preserved the value of (2+3)^3
+        { "collect", "2 'A' STO 3 'B' STO",
+          "'(A+B)^3' EXPAND COLLECT EVAL",
+          "125", false, nullptr,
+          "'A' PURGE 'B' PURGE" },
+        { "units", nullptr,
+          "1 50 START 42_km/h 1_mph Convert DROP 3_kW UBase DROP NEXT",
+          nullptr, false },
+        { "prefixes", nullptr,
+          "1 50 START 1_GiB 1_kB Convert DROP NEXT 1_GiB 1_MiB Convert",
+          "1 024 MiB", false },
+        { "parse", "\"ParseBench.48s\" RCL 'ParseBench' STO",
+          "1 ParseBench SIZE FOR i "
+          "ParseBench i GET IFERR Str→ DROP THEN END NEXT",
+          nullptr, false, nullptr,
+          "'ParseBench' PURGE \"ParseBench.48s\" PURGE" },
+        { "listget", "1 1000 FOR i i NEXT 1000 →List 'LP' STO",
+          "0 1 1000 FOR i LP i GET + NEXT",
+          "500 500", false },
+        { "listput", nullptr,
+          "1 1000 FOR i 'LP' i i NEG PUT NEXT LP 1000 GET",
+          "-1 000", false, nullptr,
+          "'LP' PURGE" },
+        { "gc100", nullptr, "GC DROP", nullptr, false,
+          "1 100 FOR i i 0.5 + NEXT" },
+        { "gc300", nullptr, "GC DROP", nullptr, false,
+          "1 300 FOR i i 0.5 + NEXT" },
+        { "gc1000", nullptr, "GC DROP", nullptr, false,
+          "1 1000 FOR i i 0.5 + NEXT" },
+        { "render",
+          "1 400 FOR i i 7 / i SQ NEXT 800 →List "
+          "« 1 10 START DUP →Text SIZE DROP NEXT » 'RenderProg' STO "
+          "'RenderList' STO",
+          "1 20 START RenderList →Text DROP 'RenderProg' RCL →Text DROP NEXT",
+          nullptr, false, nullptr,
+          "'RenderList' PURGE 'RenderProg' PURGE" },
+        { "plot", "RAD",
+          "'3*sin(x)+cos(7*x)' FunctionPlot",
+          nullptr, true },
+    };
+
+    for (auto &b : suite)
+    {
+        step(b.name);
+        if (b.setup)
+            test(CLEAR, b.setup, ENTER).noerr();
+        if (b.stack)
+            test(CLEAR, b.stack, ENTER).noerr();
+
+        // Results stay on the stack below the duration, so rotate them out
+        runtime::statistics before = rt.stats();
+        if (b.graphics)
+        {
+            // The stack is only redrawn once we leave the graphics screen
+            test(CLEAR, "Ticks ", b.code, " Ticks SWAP - 'BenchTime' STO",
+                 ENTER).wait(200)
+                .test(CLEAR, "BenchTime 'BenchTime' PURGE", ENTER);
+        }
+        else if (b.stack)
+        {
+            test("Ticks ", b.code, " Ticks SWAP -", ENTER);
+        }
+        else
+        {
+            test(CLEAR, "Ticks ", b.code,
+                 b.result ? " Ticks ROT -" : " Ticks SWAP -", ENTER);
+        }
+        benchmark(b.name, before);
+        if (b.result)
+            test(BSP).expect(b.result);
+        if (b.cleanup)
+            test(CLEAR, b.cleanup, ENTER).noerr();
+    }
+}
+
+
 // ============================================================================
 //
 //   Sequencing tests
@@ -4944,6 +5462,73 @@ tests &tests::expect(unsigned long long output)
 }
 
 
+tests &tests::elapsed(cstring label)
+// ----------------------------------------------------------------------------
+//   Report a duration in milliseconds computed on the stack using Ticks
+// ----------------------------------------------------------------------------
+{
+    record(tests, "Expecting elapsed time for %+s", label);
+    ready();
+    cindex++;
+    if (rt.error())
+    {
+        explain("Expected elapsed time for ", label, ", "
+                "got error [", rt.error(), "] instead");
+        return fail();
+    }
+    if (utf8 out = Stack.recorded())
+    {
+        // Skip digit separators in the rendered integer
+        uint ms = 0;
+        for (cstring p = cstring(out); *p; p++)
+            if (*p >= '0' && *p <= '9')
+                ms = 10 * ms + *p - '0';
+        fprintf(stderr, "%s %u ms ", label, ms);
+        return *this;
+    }
+    explain("Expected elapsed time for ", label, " but got no stack change");
+    return fail();
+}
+
+
+tests &tests::benchmark(cstring name, const runtime::statistics &before)
+// ----------------------------------------------------------------------------
+//   Report a benchmark duration and the memory statistics since `before`
+// ----------------------------------------------------------------------------
+{
+    record(tests, "Expecting benchmark result for %+s", name);
+    ready();
+    cindex++;
+    if (rt.error())
+    {
+        explain("Expected benchmark result for ", name, ", "
+                "got error [", rt.error(), "] instead");
+        return fail();
+    }
+    if (utf8 out = Stack.recorded())
+    {
+        uint ms = 0;
+        for (cstring p = cstring(out); *p; p++)
+            if (*p >= '0' && *p <= '9')
+                ms = 10 * ms + *p - '0';
+
+        const runtime::statistics &after = rt.stats();
+        uint   gcs       = after.collections - before.collections;
+        size_t allocated = after.allocated - before.allocated;
+        size_t recycled  = after.recycled - before.recycled;
+        fprintf(stderr, "%s %u ms %u GC ", name, ms, gcs);
+        fprintf(stdout,
+                "{ \"benchmark\": \"%s\", \"ms\": %u, \"gc\": %u, "
+                "\"allocated\": %zu, \"recycled\": %zu }\n",
+                name, ms, gcs, allocated, recycled);
+        fflush(stdout);
+        return *this;
+    }
+    explain("Expected benchmark result for ", name, " but got no stack change");
+    return fail();
+}
+
+
 tests &tests::match(cstring restr)
 // ----------------------------------------------------------------------------
 //   Check that the output at first level of stack matches the string
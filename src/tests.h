@@ -97,6 +97,7 @@ struct tests
     void graphic_commands();
     void online_help();
     void regression_checks();
+    void benchmarks();
 
     enum key
     {
@@ -276,6 +277,8 @@ public:
     tests &expect(long long output);
     tests &expect(unsigned long long output);
     tests &match(cstring regexp);
+    tests &elapsed(cstring label);
+    tests &benchmark(cstring name, const runtime::statistics &before);
     tests &image(cstring name, int x=0, int y=0, int w=LCD_W, int h=LCD_H);
     tests &image_noheader(cstring name);
     tests &type(object::id ty);
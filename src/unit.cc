@@ -740,6 +740,324 @@ static const si_prefix si_prefixes[] =
 
 
 
+
+// ============================================================================
+//
+//   Table of units loaded from the units file
+//
+// ============================================================================
+//   Looking up a unit tries every SI prefix, and scanning the units file for
+//   each attempt is very slow. Instead, the names in the file are indexed in
+//   a side cache in the C heap, sorted by case-folded name, along with the
+//   position of their definition in the file. Definitions are only read
+//   from the file when a name is found. Rows with a definition beginning
+//   with '=' are only shown in menus, and are not indexed. The table is
+//   rebuilt when the size or checksum of the units file change. Computing
+//   the checksum reads the whole file, so it is only done when the
+//   modification time of the file changed. On the calculator, where that
+//   time is not available, the checksum is only verified after the system
+//   menu was used, since the USB disk is the only way for the file to
+//   change behind our back.
+
+struct unit_table
+// ----------------------------------------------------------------------------
+//   Index of the unit names in the units file
+// ----------------------------------------------------------------------------
+{
+    struct entry
+    {
+        uint16_t    name;       // Offset of name in names
+        uint16_t    def;        // Offset of definition in file, NONE if absent
+        uint8_t     nlen;       // Length of name
+        uint8_t     dlen;       // Length of definition
+    };
+    enum { NONE = 0xFFFF, MAX_SIZE = 0xFFF0, MAX_LENGTH = 0xFF };
+
+    uint32_t    size;           // Size of the units file
+    uint32_t    checksum;       // Checksum of the units file
+    uint32_t    modified;       // Modification stamp of the units file
+    bool        verify;         // Verify checksum even if not modified
+    uint        count;          // Number of entries
+    size_t      bytes;          // Size of the entries and names
+    entry      *entries;        // Entries sorted by name
+    char       *names;          // Names, following the entries
+
+    bool        load(file &f);
+    symbol_p    find(utf8 name, size_t len) const;
+    void        clear();
+    static bool rows(file &f, entry *entries, char *names,
+                     uint &count, uint &nbytes);
+    static int  compare(utf8 a, size_t alen, utf8 b, size_t blen);
+    static int  sort(const void *left, const void *right);
+    static void purge();
+};
+
+static unit_table UnitTable;
+static side_cache UnitCache(unit_table::purge);
+
+
+static uint32_t unit_file_checksum(file &f, uint size)
+// ----------------------------------------------------------------------------
+//   Compute the checksum of the units file, reading it in blocks
+// ----------------------------------------------------------------------------
+{
+    char     buf[128];
+    uint32_t checksum = 0;
+    f.seek(0);
+    while (size)
+    {
+        uint len = size < sizeof(buf) ? size : sizeof(buf);
+        if (!f.read(buf, len))
+            return ~0U;
+        for (uint i = 0; i < len; i++)
+            checksum = 0x1081 * checksum ^ byte(buf[i]);
+        size -= len;
+    }
+    return checksum;
+}
+
+
+bool unit_table::load(file &f)
+// ----------------------------------------------------------------------------
+//   Make sure the table matches the units file, return false if unusable
+// ----------------------------------------------------------------------------
+{
+    if (!f.valid())
+    {
+        clear();
+        return false;
+    }
+
+    uint     fsize = f.size();
+    uint32_t stamp = f.modified();
+    if (entries && fsize == size && (stamp ? stamp == modified : !verify))
+        return true;
+
+    uint32_t fsum  = unit_file_checksum(f, fsize);
+    verify = false;
+    if (entries && fsize == size && fsum == checksum)
+    {
+        modified = stamp;
+        return true;
+    }
+
+    clear();
+    if (!fsize || fsize > MAX_SIZE)
+        return false;
+
+    uint n = 0;
+    uint nbytes = 0;
+    if (!rows(f, nullptr, nullptr, n, nbytes))
+        return false;
+    size_t total = (n ? n : 1) * sizeof(entry) + nbytes;
+    entries = (entry *) UnitCache.resize(nullptr, 0, total);
+    if (!entries)
+        return false;
+    bytes = total;
+    names = (char *) (entries + (n ? n : 1));
+    if (!rows(f, entries, names, count, nbytes) || count != n)
+    {
+        clear();
+        return false;
+    }
+    qsort(entries, count, sizeof(entry), sort);
+
+    size     = fsize;
+    checksum = fsum;
+    modified = stamp;
+    record(units, "Indexed %u units from %u bytes units file in %u bytes",
+           count, size, bytes);
+    return true;
+}
+
+
+void unit_table::clear()
+// ----------------------------------------------------------------------------
+//   Release the memory used by the table
+// ----------------------------------------------------------------------------
+{
+    UnitCache.release(entries, bytes);
+    entries  = nullptr;
+    names    = nullptr;
+    bytes    = 0;
+    count    = 0;
+    size     = 0;
+    checksum = 0;
+    modified = 0;
+}
+
+
+void unit_table::purge()
+// ----------------------------------------------------------------------------
+//   Release the table when another side cache needs the memory
+// ----------------------------------------------------------------------------
+{
+    UnitTable.clear();
+}
+
+
+bool unit_table::rows(file &f, entry *entries, char *names,
+                      uint &count, uint &nbytes)
+// ----------------------------------------------------------------------------
+//   Split the file in rows, like unit_file::lookup does
+// ----------------------------------------------------------------------------
+//   Count the rows and the bytes in their names, and record them if
+//   entries is not null. Return false if a row does not fit in an entry.
+{
+    uint  column = 0;
+    uint  start  = 0;
+    bool  quoted = false;
+    bool  menu   = false;
+    entry row    = { 0, NONE, 0, 0 };
+
+    count  = 0;
+    nbytes = 0;
+    f.seek(0);
+    for (uint i = 0; ; i++)
+    {
+        char c = f.getchar();
+        if (c == '"')
+        {
+            quoted = !quoted;
+            if (quoted)
+            {
+                start = i + 1;
+                if (column == 0)
+                    row = { uint16_t(nbytes), NONE, 0, 0 };
+            }
+            else
+            {
+                if (column == 1)
+                {
+                    if (i - start > MAX_LENGTH)
+                        return false;
+                    row.def  = start;
+                    row.dlen = i - start;
+                }
+                column++;
+            }
+        }
+        else if (c == '\n' || !c)
+        {
+            if (column)
+            {
+                if (menu)
+                {
+                    nbytes -= row.nlen;
+                }
+                else
+                {
+                    if (entries)
+                        entries[count] = row;
+                    count++;
+                }
+            }
+            column = 0;
+            menu   = false;
+            if (!c)
+                break;
+        }
+        else if (quoted && column == 0)
+        {
+            if (row.nlen == MAX_LENGTH)
+                return false;
+            if (names)
+                names[nbytes] = c;
+            nbytes++;
+            row.nlen++;
+        }
+        else if (quoted && column == 1 && i == start)
+        {
+            menu = c == '=';
+        }
+    }
+    return true;
+}
+
+
+int unit_table::compare(utf8 a, size_t alen, utf8 b, size_t blen)
+// ----------------------------------------------------------------------------
+//   Case-insensitive comparison of unit names
+// ----------------------------------------------------------------------------
+{
+    size_t len = alen < blen ? alen : blen;
+    for (size_t i = 0; i < len; i++)
+    {
+        byte ca = a[i];
+        byte cb = b[i];
+        if (ca >= 'A' && ca <= 'Z')
+            ca += 'a' - 'A';
+        if (cb >= 'A' && cb <= 'Z')
+            cb += 'a' - 'A';
+        if (ca != cb)
+            return ca < cb ? -1 : 1;
+    }
+    return alen < blen ? -1 : alen > blen ? 1 : 0;
+}
+
+
+int unit_table::sort(const void *left, const void *right)
+// ----------------------------------------------------------------------------
+//   Sort entries by name, keeping the order of the file for identical names
+// ----------------------------------------------------------------------------
+{
+    const entry *l     = (const entry *) left;
+    const entry *r     = (const entry *) right;
+    utf8         names = utf8(UnitTable.names);
+    if (int cmp = compare(names + l->name, l->nlen, names + r->name, r->nlen))
+        return cmp;
+    return int(l->name) - int(r->name);
+}
+
+
+symbol_p unit_table::find(utf8 name, size_t len) const
+// ----------------------------------------------------------------------------
+//   Find the definition for a unit name, reading it from the units file
+// ----------------------------------------------------------------------------
+//   Like unit_file::lookup, stop at a row without definition
+{
+    utf8 base = utf8(names);
+    uint lo   = 0;
+    uint hi   = count;
+    while (lo < hi)
+    {
+        uint mid = (lo + hi) / 2;
+        const entry &e = entries[mid];
+        if (compare(base + e.name, e.nlen, name, len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo >= count)
+        return nullptr;
+    const entry &e = entries[lo];
+    if (compare(base + e.name, e.nlen, name, len) != 0 || e.def == NONE)
+        return nullptr;
+
+    // Read the definition from the file, closed again when we return
+    uint      def  = e.def;
+    uint      dlen = e.dlen;
+    unit_file ufile;
+    scribble  scr;
+    byte     *buf  = dlen ? rt.allocate(dlen) : nullptr;
+    if (!ufile.valid() || (dlen && !buf))
+        return nullptr;
+    ufile.seek(def);
+    if (dlen && !ufile.read((char *) buf, dlen))
+        return nullptr;
+    return symbol::make(scr.scratch(), dlen);
+}
+
+
+void unit::table_invalidate()
+// ----------------------------------------------------------------------------
+//   Verify the units file checksum on the next lookup
+// ----------------------------------------------------------------------------
+{
+    UnitTable.verify = true;
+}
+
+
 unit_p unit::lookup(symbol_p name, int *prefix_info)
 // ----------------------------------------------------------------------------
 //   Lookup a built-in unit
@@ -749,6 +1067,9 @@ unit_p unit::lookup(symbol_p name, int *prefix_info)
     gcutf8    gtxt = name->value(&len);
     uint      maxs = sizeof(si_prefixes) / sizeof(si_prefixes[0]);
     unit_file ufile;
+    bool      table = UnitTable.load(ufile);
+    if (table)
+        ufile.close();          // Can't have 2 files open on DM42
 
     for (uint si = 0; si < maxs; si++)
     {
@@ -769,9 +1090,21 @@ unit_p unit::lookup(symbol_p name, int *prefix_info)
             cstring utxt = nullptr;
             cstring udef = nullptr;
             size_t  ulen = 0;
+            symbol_g fsym = nullptr;
 
             // Check in-file units
-            if (ufile.valid())
+            if (table)
+            {
+                fsym = UnitTable.find(txt, rlen);
+                ntxt = gtxt;    // Reading the definition may move the name
+                txt  = ntxt + plen + kibi;
+                if (fsym)
+                {
+                    udef = cstring(fsym->value(&ulen));
+                    utxt = cstring(txt);
+                }
+            }
+            else if (ufile.valid())
             {
                 bool first = true;
                 while (symbol_p def = ufile.lookup(txt, rlen, false, first))
@@ -126,7 +126,9 @@ user_interface::user_interface()
       adjustSeps(false),
       graphics(false),
       dbl_release(false),
-      helpfile()
+      helpfile(),
+      helpsize(0),
+      helpindex(0)
 {
     for (uint p = 0; p < NUM_PLANES; p++)
     {
@@ -1655,6 +1657,306 @@ bool user_interface::draw_idle()
 }
 
 
+// ============================================================================
+//
+//   Editor line index
+//
+// ============================================================================
+//   Drawing the editor used to walk the whole buffer on every redraw, to
+//   count rows, find the cursor row and move up or down. Instead, we keep
+//   the offset of the start of each line, updated incrementally when text
+//   is inserted or removed. We also remember how the editor was laid out
+//   on screen, so that when only some lines changed, only those lines are
+//   measured and redrawn. Like other side caches, the index lives in the
+//   C heap within the shared side cache budget, and if it cannot be
+//   allocated, we fall back to scanning.
+
+struct editor_layout
+// ----------------------------------------------------------------------------
+//   Line index and on-screen layout of the command-line editor
+// ----------------------------------------------------------------------------
+{
+    uint *      starts;         // Offset of the first byte of each line
+    uint        count;          // Number of lines, 0 = not indexed
+    uint        capacity;       // Number of offsets allocated
+    size_t      length;         // Size of the editor when indexed
+
+    // What is currently on screen
+    bool        drawn;          // Screen matches the layout below
+    bool        selected;       // A selection was shown
+    font_p      font;           // Font used for the editor
+    coord       top;            // Top of the editor area
+    coord       bottom;         // Bottom of the editor area
+    coord       y;              // Vertical position of the first row shown
+    coord       xoffset;        // Horizontal scrolling
+    uint        first;          // First line shown
+    uint        lines;          // Number of lines in the editor
+    uint        row;            // Row of the cursor
+    uint        dirtyFirst;     // First line modified since drawn
+    uint        dirtyLast;      // Last line modified since drawn
+
+    bool        index(utf8 ed, size_t len);
+    bool        reserve(uint n);
+    void        inserted(utf8 ed, size_t len, size_t offset, size_t sz);
+    void        removed(size_t len, size_t offset, size_t sz);
+    uint        rows(utf8 ed, size_t len);
+    uint        line(utf8 ed, size_t len, size_t offset);
+    size_t      start(utf8 ed, size_t len, uint row);
+    size_t      end(utf8 ed, size_t len, uint row);
+
+    static void purge();
+
+    void        forget()        { count = 0; drawn = false; }
+    void        overdrawn()     { drawn = false; }
+    void        clean()         { dirtyFirst = ~0U; dirtyLast = 0; }
+    bool        dirty(uint r)   { return r >= dirtyFirst && r <= dirtyLast; }
+    void        touch(uint r)
+    {
+        if (dirtyFirst > r)
+            dirtyFirst = r;
+        if (dirtyLast < r)
+            dirtyLast = r;
+    }
+};
+
+static editor_layout EditorLayout;
+static side_cache    EditorCache(editor_layout::purge);
+
+
+bool editor_layout::reserve(uint n)
+// ----------------------------------------------------------------------------
+//   Make sure we have room for the given number of lines
+// ----------------------------------------------------------------------------
+{
+    if (n <= capacity)
+        return true;
+    uint  ncap  = n + n / 4 + 16;
+    void *table = EditorCache.resize(starts,
+                                     capacity * sizeof(uint),
+                                     ncap * sizeof(uint));
+    if (!table)
+        return false;
+    starts = (uint *) table;
+    capacity = ncap;
+    return true;
+}
+
+
+void editor_layout::purge()
+// ----------------------------------------------------------------------------
+//   Release the line index when another side cache needs the memory
+// ----------------------------------------------------------------------------
+{
+    editor_layout &layout = EditorLayout;
+    layout.forget();
+    EditorCache.release(layout.starts, layout.capacity * sizeof(uint));
+    layout.starts = nullptr;
+    layout.capacity = 0;
+}
+
+
+bool editor_layout::index(utf8 ed, size_t len)
+// ----------------------------------------------------------------------------
+//   Make sure the index matches the editor, rebuild it if necessary
+// ----------------------------------------------------------------------------
+{
+    if (count && length == len)
+        return true;
+
+    drawn = false;
+    count = 0;
+    uint n = 1;
+    for (size_t o = 0; o < len; o++)
+        if (ed[o] == '\n')
+            n++;
+    if (!reserve(n))
+        return false;
+
+    starts[0] = 0;
+    for (size_t o = 0; o < len; o++)
+        if (ed[o] == '\n')
+            starts[++count] = o + 1;
+    count = n;
+    length = len;
+    record(text_editor, "Indexed editor, %u bytes, %u lines", len, n);
+    return true;
+}
+
+
+void editor_layout::inserted(utf8 ed, size_t len, size_t offset, size_t sz)
+// ----------------------------------------------------------------------------
+//   Record that sz bytes were inserted at offset, len is the new size
+// ----------------------------------------------------------------------------
+{
+    if (!count || length + sz != len)
+    {
+        forget();
+        return;
+    }
+
+    uint   k = line(ed, length, offset);
+    uint   n = 0;
+    for (size_t o = offset; o < offset + sz; o++)
+        if (ed[o] == '\n')
+            n++;
+    if (n && !reserve(count + n))
+    {
+        forget();
+        return;
+    }
+
+    // Shift the following lines, and insert the new ones after line k
+    for (uint i = count; i > k + 1; i--)
+        starts[i - 1 + n] = starts[i - 1] + sz;
+    uint i = k + 1;
+    for (size_t o = offset; o < offset + sz; o++)
+        if (ed[o] == '\n')
+            starts[i++] = o + 1;
+    count += n;
+    length = len;
+    touch(k);
+}
+
+
+void editor_layout::removed(size_t len, size_t offset, size_t sz)
+// ----------------------------------------------------------------------------
+//   Record that sz bytes were removed at offset, len is the new size
+// ----------------------------------------------------------------------------
+{
+    if (!count || length != len + sz)
+    {
+        forget();
+        return;
+    }
+
+    // Lines starting in the removed range are merged into line k
+    uint k = line(nullptr, length, offset);
+    uint j = k + 1;
+    while (j < count && starts[j] <= offset + sz)
+        j++;
+    uint gone = j - (k + 1);
+    for (uint i = j; i < count; i++)
+        starts[i - gone] = starts[i] - sz;
+    count -= gone;
+    length = len;
+    touch(k);
+}
+
+
+uint editor_layout::rows(utf8 ed, size_t len)
+// ----------------------------------------------------------------------------
+//   Return the number of rows in the editor
+// ----------------------------------------------------------------------------
+{
+    if (index(ed, len))
+        return count;
+    uint n = 1;
+    for (size_t o = 0; o < len; o++)
+        if (ed[o] == '\n')
+            n++;
+    return n;
+}
+
+
+uint editor_layout::line(utf8 ed, size_t len, size_t offset)
+// ----------------------------------------------------------------------------
+//   Return the line containing the given offset
+// ----------------------------------------------------------------------------
+//   When called with a null editor, the index is assumed to be valid
+{
+    if (!ed || index(ed, len))
+    {
+        uint lo = 0;
+        uint hi = count;
+        while (hi - lo > 1)
+        {
+            uint mid = (lo + hi) / 2;
+            if (starts[mid] <= offset)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    uint r = 0;
+    for (size_t o = 0; o < offset && o < len; o++)
+        if (ed[o] == '\n')
+            r++;
+    return r;
+}
+
+
+size_t editor_layout::start(utf8 ed, size_t len, uint row)
+// ----------------------------------------------------------------------------
+//   Return the offset of the start of a line
+// ----------------------------------------------------------------------------
+{
+    if (index(ed, len))
+        return row < count ? starts[row] : len;
+
+    size_t o = 0;
+    for (uint r = 0; r < row && o < len; o++)
+        if (ed[o] == '\n')
+            r++;
+    return o;
+}
+
+
+size_t editor_layout::end(utf8 ed, size_t len, uint row)
+// ----------------------------------------------------------------------------
+//   Return the offset of the end of a line, i.e. its newline or the end
+// ----------------------------------------------------------------------------
+{
+    if (index(ed, len))
+        return row + 1 < count ? starts[row + 1] - 1 : len;
+
+    size_t o = start(ed, len, row);
+    while (o < len && ed[o] != '\n')
+        o++;
+    return o;
+}
+
+
+void user_interface::editor_inserted(size_t offset, size_t len)
+// ----------------------------------------------------------------------------
+//   Update the editor line index after text was inserted
+// ----------------------------------------------------------------------------
+{
+    EditorLayout.inserted(rt.editor(), rt.editing(), offset, len);
+}
+
+
+void user_interface::editor_removed(size_t offset, size_t len)
+// ----------------------------------------------------------------------------
+//   Update the editor line index after text was removed
+// ----------------------------------------------------------------------------
+{
+    EditorLayout.removed(rt.editing(), offset, len);
+}
+
+
+void user_interface::editor_reset()
+// ----------------------------------------------------------------------------
+//   Forget the editor line index, e.g. when opening or closing the editor
+// ----------------------------------------------------------------------------
+{
+    EditorLayout.forget();
+}
+
+
+static coord editor_width(font_p font, utf8 first, utf8 last)
+// ----------------------------------------------------------------------------
+//   Measure the width of some text in the editor
+// ----------------------------------------------------------------------------
+{
+    coord width = 0;
+    for (utf8 p = first; p < last; p = utf8_next(p))
+        width += font->width(utf8_codepoint(p));
+    return width;
+}
+
+
 bool user_interface::draw_editor()
 // ----------------------------------------------------------------------------
 //   Draw the editor
@@ -1677,6 +1979,7 @@ bool user_interface::draw_editor()
     if (!len)
     {
         // Editor is not open, compute stack bottom
+        EditorLayout.forget();
         int ns = LCD_H - menuHeight;
         if (stack != ns)
         {
@@ -1686,126 +1989,69 @@ bool user_interface::draw_editor()
         return false;
     }
 
-    // Select font
-    font_p font = Settings.editor_font(false);
-
-    // Count rows and colums
-    int  rows   = 1;            // Number of rows in editor
-    int  cwidth = 0;            // Column width
-    int  edrow  = 0;            // Row number of line being edited
-    int  cursx  = 0;            // Cursor X position
-    bool found  = false;
-
     byte *wed = (byte *) ed;
     wed[len] = 0;               // Ensure utf8_next does not go into the woods
 
-    // Count rows to check if we need to switch to stack font
-    if (!edRows)
-    {
-        for (utf8 p = ed; p < last; p = utf8_next(p))
-            if (*p == '\n')
-                rows++;
-        edRows = rows;
-
-        font = Settings.editor_font(rows > 2);
-
-        rows = 1;
-        for (utf8 p = ed; p < last; p = utf8_next(p))
-        {
-            if (p - ed == (int) cursor)
-            {
-                edrow = rows - 1;
-                cursx = cwidth;
-                found = true;
-            }
-
-            if (*p == '\n')
-            {
-                rows++;
-                cwidth = 0;
-            }
-            else
-            {
-                unicode cp  = utf8_codepoint(p);
-                cwidth     += font->width(cp);
-            }
-        }
-        if (!found)
-        {
-            edrow = rows - 1;
-            cursx = cwidth;
-        }
-
-        edRow = edrow;
-
-        record(text_editor, "Computed: row %d/%d cursx %d (%d+%d=%d)",
-               edrow, rows, cursx, cx, xoffset, cx+xoffset);
-    }
-    else
-    {
-        rows  = edRows;
-        edrow = edRow;
-        cursx = cx + xoffset;
-        font = Settings.editor_font(rows > 2);
+    // Find rows and cursor row from the line index
+    editor_layout &layout = EditorLayout;
+    int    rows   = layout.rows(ed, len);
+    int    edrow  = layout.line(ed, len, cursor);
+    font_p font   = Settings.editor_font(rows > 2);
+    utf8   lstart = ed + layout.start(ed, len, edrow);
+    coord  cursx  = editor_width(font, lstart, min(ed + cursor, last));
+    edRows = rows;
 
-        record(text_editor, "Cached: row %d/%d cursx %d (%d+%d)",
-               edrow, rows, cursx, cx, xoffset, cx+xoffset);
-    }
+    record(text_editor, "Indexed: row %d/%d cursx %d (%d+%d=%d)",
+           edrow, rows, cursx, cx, xoffset, cx+xoffset);
 
     // Check if we want to move the cursor up or down
     if (up || down)
     {
-        int   r    = 0;
-        coord c    = 0;
-        int   tgt  = edrow - (up && edrow > 0) + down;
-        bool  done = up && edrow == 0;
+        int tgt = edrow - (up && edrow > 0) + down;
 
         record(text_editor,
                "Moving %+s%+s edrow=%d target=%d curs=%d cursx=%d edcx=%d",
                up ? "up" : "", down ? "down" : "",
                edrow, tgt, cursor, cursx, edColumn);
 
-        for (utf8 p   = ed; p < last && !done; p = utf8_next(p))
+        if (tgt >= rows)
         {
-            if (*p == '\n')
-            {
-                r++;
-                if (r > tgt)
-                {
-                    cursor = p - ed;
-                    edrow  = tgt;
-                    done   = true;
-                }
-            }
-            else if (r == tgt)
+            cursor = len;
+            edrow = rows - 1;
+        }
+        else if (tgt != edrow)
+        {
+            // Only measure the target line
+            utf8  p = ed + layout.start(ed, len, tgt);
+            utf8  e = ed + layout.end(ed, len, tgt);
+            coord c = 0;
+            cursor = e - ed;
+            for (; p < e; p = utf8_next(p))
             {
-                unicode cp = utf8_codepoint(p);
-                c += font->width(cp);
+                c += font->width(utf8_codepoint(p));
                 if (c > edColumn)
                 {
                     cursor = p - ed;
-                    edrow = r;
-                    done = true;
+                    break;
                 }
             }
+            edrow = tgt;
         }
-        if (!done && down)
-        {
-            cursor = len;
-            edrow = rows - 1;
-        }
+        lstart = ed + layout.start(ed, len, edrow);
+        cursx = editor_width(font, lstart, min(ed + cursor, last));
+
         record(text_editor, "Moved %+s%+s row=%d curs=%d",
                up ? "up" : "", down ? "down" : "",
                edrow, cursor);
 
         up   = false;
         down = false;
-        edRow = edrow;
     }
     else
     {
         edColumn = cursx;
     }
+    edRow = edrow;
 
     // Draw the area that fits on the screen
     int   lineHeight      = font->height();
@@ -1815,7 +2061,8 @@ bool user_interface::draw_editor()
     int   availableHeight = bottom - top;
     int   fullRows        = availableHeight / lineHeight;
     int   clippedRows     = (availableHeight + lineHeight - 1) / lineHeight;
-    utf8  display         = ed;
+    int   first           = 0;
+    int   shown           = rows;
     coord y               = bottom - rows * lineHeight;
 
     blitter::rect clip = Screen.clip();
@@ -1825,27 +2072,16 @@ bool user_interface::draw_editor()
     {
         // Skip rows to show the cursor
         int half = fullRows / 2;
-        int skip = edrow < half         ? 0
-                 : edrow >= rows - half ? rows - fullRows
-                                        : edrow - half;
+        first = edrow < half         ? 0
+              : edrow >= rows - half ? rows - fullRows
+                                     : edrow - half;
         record(text_editor,
                "Available %d, ed %d, displaying %d, skipping %d",
                fullRows,
                edrow,
                clippedRows,
-               skip);
-
-        for (int r = 0; r < skip; r++)
-        {
-            do
-                display = utf8_next(display);
-            while (*display != '\n');
-        }
-        if (skip)
-            display = utf8_next(display);
-        record(text_editor, "Truncated from %d to %d, text=%s",
-               rows, clippedRows, display);
-        rows = clippedRows;
+               first);
+        shown = clippedRows;
         y = top;
     }
 
@@ -1858,9 +2094,6 @@ bool user_interface::draw_editor()
     else if (coord(xoffset + LCD_W - cursw) < cursx)
         xoffset = cursx - LCD_W + cursw + hskip;
 
-    coord x = -xoffset;
-    int   r = 0;
-
     if (y < top)
         y = top;
     if (stack != y - 1)
@@ -1868,51 +2101,96 @@ bool user_interface::draw_editor()
         stack      = y - 1;
         dirtyStack = true;
     }
-    Screen.fill(0, stack, LCD_W, bottom, pattern::white);
-    draw_dirty(0, stack, LCD_W, bottom);
 
-    while (r < rows && display <= last)
+    // If the layout did not change, only redraw modified lines
+    bool partial = !force && layout.drawn && !layout.selected && !~select
+        && layout.font == font && layout.top == top
+        && layout.bottom == bottom && layout.y == y
+        && layout.xoffset == xoffset && layout.first == uint(first)
+        && layout.lines == uint(rows);
+    if (partial)
+    {
+        layout.touch(layout.row);
+        layout.touch(edrow);
+    }
+    else
     {
-        bool atCursor = display == ed + cursor;
-        if (atCursor)
+        Screen.fill(0, stack, LCD_W, bottom, pattern::white);
+        draw_dirty(0, stack, LCD_W, bottom);
+    }
+    record(text_editor, "Drawing %+s, lines %u-%u",
+           partial ? "modified lines" : "all lines",
+           layout.dirtyFirst, layout.dirtyLast);
+
+    for (int r = 0; r < shown && first + r < rows; r++)
+    {
+        uint row = first + r;
+        if (partial && !layout.dirty(row))
+            continue;
+
+        coord  ry = y + r * lineHeight;
+        size_t e  = layout.end(ed, len, row);
+        coord  x  = -xoffset;
+        if (partial)
         {
-            cx = x;
-            cy = y;
+            Screen.fill(0, ry, LCD_W, ry + lineHeight - 1, pattern::white);
+            draw_dirty(0, ry, LCD_W, ry + lineHeight - 1);
         }
-        if (display >= last)
-            break;
 
-        unicode c   = utf8_codepoint(display);
-        uint    pos = display - ed;
-        bool    sel = ~select && int((pos - cursor) ^ (pos - select)) < 0;
-        display     = utf8_next(display);
-        if (c == '\n')
+        for (utf8 p = ed + layout.start(ed, len, row); p < ed + e;
+             p = utf8_next(p))
         {
-            if (sel && x >= 0 && x < LCD_W)
-                Screen.fill(x, y, LCD_W, y + lineHeight - 1, pattern::black);
-            y += lineHeight;
-            x  = -xoffset;
-            r++;
-            continue;
+            uint pos = p - ed;
+            if (pos == cursor)
+            {
+                cx = x;
+                cy = ry;
+            }
+
+            unicode c   = utf8_codepoint(p);
+            bool    sel = ~select && int((pos - cursor) ^ (pos - select)) < 0;
+            int     cw  = font->width(c);
+            if (x + cw >= 0 && x < LCD_W)
+            {
+                pattern fg = sel ? pattern::white : pattern::black;
+                pattern bg = sel ? (~searching ? pattern::gray25
+                                               : pattern::black)
+                                 : pattern::white;
+                x = Screen.glyph(x, ry, c, font, fg, bg);
+            }
+            else
+            {
+                x += cw;
+            }
         }
-        int cw = font->width(c);
-        if (x + cw >= 0 && x < LCD_W)
+
+        // Cursor at end of line, and selected line ending
+        if (cursor == e || (e == len && cursor > len))
         {
-            pattern fg  = sel ? pattern::white : pattern::black;
-            pattern bg  = sel ? (~searching ? pattern::gray25 : pattern::black)
-                              : pattern::white;
-            x = Screen.glyph(x, y, c, font, fg, bg);
+            cx = x;
+            cy = ry;
         }
-        else
+        if (e < len)
         {
-            x += cw;
+            uint pos = e;
+            bool sel = ~select && int((pos - cursor) ^ (pos - select)) < 0;
+            if (sel && x >= 0 && x < LCD_W)
+                Screen.fill(x, ry, LCD_W, ry + lineHeight - 1, pattern::black);
         }
     }
-    if (cursor >= len)
-    {
-        cx = x;
-        cy = y;
-    }
+
+    // Remember the layout for the next time
+    layout.drawn    = true;
+    layout.selected = ~select != 0;
+    layout.font     = font;
+    layout.top      = top;
+    layout.bottom   = bottom;
+    layout.y        = y;
+    layout.xoffset  = xoffset;
+    layout.first    = first;
+    layout.lines    = rows;
+    layout.row      = edrow;
+    layout.clean();
 
     Screen.clip(clip);
 
@@ -2041,6 +2319,7 @@ bool user_interface::draw_command()
             coord  x    = 25;
             coord  y    = HeaderFont->height() + 6;
 
+            EditorLayout.overdrawn();
             Screen.fill(x-2, y-1, x+w+2, y+h+1, pattern::black);
             Screen.text(x, y, command, font, pattern::white);
             draw_dirty(x-2, y-1, x+w+2, y+h+1);
@@ -2064,6 +2343,7 @@ void user_interface::draw_user_command(utf8 cmd, size_t len)
     coord  y    = HeaderFont->height() + 6;
 
     // Erase normal command
+    EditorLayout.overdrawn();
     Screen.fill(x-2, y-1, x + w + 2, y + h + 1, pattern::gray50);
 
     // Draw user command
@@ -2159,6 +2439,7 @@ bool user_interface::draw_message(utf8 header, uint count, utf8 msgs[])
     rect   clip   = Screen.clip();
     rect   r(x, y, x + width - 1, y + height - 1);
 
+    EditorLayout.overdrawn();
     draw_dirty(r);
     Screen.fill(r, pattern::gray50);
     r.inset(1);
@@ -2215,44 +2496,365 @@ bool user_interface::draw_stack()
 }
 
 
-void user_interface::load_help(utf8 topic, size_t len)
+// ============================================================================
+//
+//   Help topic index
+//
+// ============================================================================
+//   Finding a topic used to require scanning the whole help file for every
+//   lookup. Instead, we keep an index file next to the help file, containing
+//   the hashes of all the topic names a heading could match, each with the
+//   offset of the heading, sorted by hash. A lookup is then a binary search
+//   in the index, followed by checking the candidate headings. The index
+//   records the size of the help file it was built for and a checksum of
+//   samples spread over it, and is rebuilt when they change. Checking them
+//   does not require reading the whole help file, and is only done once
+//   per session, or after the system menu was used, since the USB disk is
+//   the only way for the file to change behind our back.
+//   Only one file can be open at a time on the calculator, so the help file
+//   is closed while the index is read or written. A lookup collects the
+//   offsets of candidate headings from the index, closes the index, and then
+//   reopens the help file to check them.
+
+struct help_index_header
+// ----------------------------------------------------------------------------
+//   Header of the help index file
 // ----------------------------------------------------------------------------
-//   Find the help message associated with the topic
+{
+    uint32_t    magic;          // Identifies a help index file
+    uint32_t    size;           // Size of the help file
+    uint32_t    checksum;       // Checksum of samples of the help file
+    uint32_t    count;          // Number of entries
+};
+
+
+struct help_index_entry
+// ----------------------------------------------------------------------------
+//   An entry in the help index
 // ----------------------------------------------------------------------------
 {
-    record(help, "Loading help topic %s", topic);
+    uint32_t    hash;           // Hash of the topic name
+    uint32_t    offset;         // Offset of the heading in the help file
+};
 
-    if (!len)
-        len = strlen(cstring(topic));
-    command   = nullptr;
-    follow    = false;
-    dirtyHelp = true;
+static const uint32_t HELP_INDEX_MAGIC = 0x58444948; // "HIDX"
+static const size_t   HELP_LINE_MAX    = 160;        // Longest indexed heading
+static const uint     HELP_SAMPLES     = 32;         // Samples in checksum
+static const uint     HELP_SAMPLE_SIZE = 32;         // Bytes per sample
+static const uint     HELP_CANDIDATES  = 16;         // Headings checked
 
-    // Need to have the help file open here
-    if (!helpfile.valid())
+
+static inline uint32_t help_hash(uint32_t hash, byte c)
+// ----------------------------------------------------------------------------
+//   Case-folded hash, where space and dash hash identically
+// ----------------------------------------------------------------------------
+//   This must hash identically anything that help_match considers equal
+{
+    if (c >= 'A' && c <= 'Z')
+        c += 'a' - 'A';
+    else if (c == ' ')
+        c = '-';
+    return (hash ^ c) * 16777619u;
+}
+
+
+static uint help_keys(const byte *line, size_t len, uint32_t offset,
+                      help_index_entry *entries)
+// ----------------------------------------------------------------------------
+//   Hash all the topic names that a heading line could match
+// ----------------------------------------------------------------------------
+//   A topic can begin after the leading '#', a space, a '(' or a ',', and
+//   must be followed by a newline, a space, a ')' or a ','.
+{
+    uint count = 0;
+    for (size_t s = 1; s < len; s++)
     {
-        helpfile.open(HELPFILE_NAME);
-        if (!helpfile.valid())
+        byte c = line[s];
+        byte p = line[s-1];
+        if (c == ' ' || c == '#' || c == '\n')
+            continue;
+        if (p != '#' && p != ' ' && p != '(' && p != ',')
+            continue;
+
+        uint32_t hash = 2166136261u;
+        for (size_t e = s; e < len; e++)
         {
-            help = -1u;
-            line = 0;
-            return;
+            c = line[e];
+            if (e > s && (c == '\n' || c == ' ' || c == ')' || c == ','))
+            {
+                if (entries)
+                    entries[count] = help_index_entry{ hash, offset };
+                count++;
+            }
+            hash = help_hash(hash, c);
         }
     }
-    dirtyMenu = true;
+    return count;
+}
+
+
+static bool help_scan(file &help, help_index_entry *entries, uint &count)
+// ----------------------------------------------------------------------------
+//   Scan the help file and collect index entries
+// ----------------------------------------------------------------------------
+//   If entries is null, only count them. Return false if a heading line
+//   is too long to be indexed.
+{
+    byte   line[HELP_LINE_MAX];
+    size_t len     = 0;
+    uint   offset  = 0;
+    bool   heading = false;
+    bool   hadcr   = true;
+    bool   ok      = true;
+
+    count = 0;
+    help.seek(0);
+    for (uint pos = 0; ; pos++)
+    {
+        char c   = help.getchar();
+        bool end = !c;
+        if (end)
+            c = '\n';           // Close any heading on the last line
+
+        if (hadcr)
+        {
+            heading = c == '#';
+            offset  = pos;
+            len     = 0;
+        }
+        if (heading)
+        {
+            if (len < HELP_LINE_MAX)
+                line[len++] = c;
+            else
+                ok = false;
+            if (c == '\n')
+            {
+                uint n = help_keys(line, len, offset,
+                                   entries ? entries + count : nullptr);
+                count += n;
+                heading = false;
+            }
+        }
+        hadcr = c == '\n';
+        if (end)
+            break;
+    }
+    return ok;
+}
+
+
+static uint32_t help_checksum(file &help, uint size)
+// ----------------------------------------------------------------------------
+//   Checksum of samples spread evenly over the help file
+// ----------------------------------------------------------------------------
+{
+    uint32_t checksum = size;
+    for (uint s = 0; s < HELP_SAMPLES; s++)
+    {
+        help.seek(uint(uint64_t(size) * s / HELP_SAMPLES));
+        for (uint i = 0; i < HELP_SAMPLE_SIZE; i++)
+            checksum = 0x1081 * checksum ^ byte(help.getchar());
+    }
+    return checksum;
+}
+
+
+static int help_index_compare(const void *left, const void *right)
+// ----------------------------------------------------------------------------
+//   Sort index entries by hash, then by position in the help file
+// ----------------------------------------------------------------------------
+{
+    const help_index_entry *l = (const help_index_entry *) left;
+    const help_index_entry *r = (const help_index_entry *) right;
+    if (l->hash != r->hash)
+        return l->hash < r->hash ? -1 : 1;
+    if (l->offset != r->offset)
+        return l->offset < r->offset ? -1 : 1;
+    return 0;
+}
+
+
+static cstring help_index_name()
+// ----------------------------------------------------------------------------
+//   Name of the help index file, e.g. help/db48x.idx for help/db48x.md
+// ----------------------------------------------------------------------------
+{
+    static char name[sizeof(HELPFILE_NAME) + 4];
+    if (!name[0])
+    {
+        strcpy(name, HELPFILE_NAME);
+        char *ext = strrchr(name, '.');
+        if (!ext)
+            ext = name + strlen(name);
+        strcpy(ext, ".idx");
+    }
+    return name;
+}
+
+
+void user_interface::help_index_check()
+// ----------------------------------------------------------------------------
+//   Check that the help index matches the help file, rebuild it if not
+// ----------------------------------------------------------------------------
+{
+    uint size = helpfile.size();
+    if (size == helpsize)
+        return;                 // Already checked for this help file
+
+    helpsize  = size;
+    helpindex = 0;
+
+    // Check if we have a valid index file for this help file
+    uint32_t checksum = help_checksum(helpfile, size);
+    helpfile.close();
+    {
+        help_index_header hdr;
+        file index(help_index_name(), false);
+        if (index.valid() &&
+            index.read((char *) &hdr, sizeof(hdr)) &&
+            hdr.magic == HELP_INDEX_MAGIC &&
+            hdr.size == size &&
+            hdr.checksum == checksum &&
+            hdr.count)
+        {
+            record(help, "Using help index with %u entries", hdr.count);
+            helpindex = hdr.count;
+        }
+    }
+    helpfile.open(HELPFILE_NAME);
+    if (helpindex || !helpfile.valid())
+        return;
+
+    uint count = 0;
+    if (!help_scan(helpfile, nullptr, count) || !count)
+    {
+        record(help, "Help file cannot be indexed");
+        return;
+    }
+
+    // Build the index in the scratchpad, and write it to disk
+    size_t scratch = count * sizeof(help_index_entry)
+                   + sizeof(help_index_entry) - 1;
+    byte  *buffer  = rt.allocate(scratch);
+    if (!buffer)
+    {
+        rt.clear_error();
+        return;
+    }
+    uintptr_t aligned = uintptr_t(buffer) + sizeof(help_index_entry) - 1;
+    aligned &= ~uintptr_t(alignof(help_index_entry) - 1);
+    help_index_entry *entries = (help_index_entry *) aligned;
+    help_scan(helpfile, entries, count);
+    qsort(entries, count, sizeof(help_index_entry), help_index_compare);
+
+    helpfile.close();
+    {
+        help_index_header hdr = { HELP_INDEX_MAGIC, size, checksum, count };
+        file index(help_index_name(), true);
+        if (index.valid() &&
+            index.write((const char *) &hdr, sizeof(hdr)) &&
+            index.write((const char *) entries, count * sizeof(*entries)) &&
+            index.close())
+        {
+            record(help, "Built help index with %u entries", count);
+            helpindex = count;
+        }
+    }
+    rt.free(scratch);
+    helpfile.open(HELPFILE_NAME);
+}
+
+
+void user_interface::help_index_invalidate()
+// ----------------------------------------------------------------------------
+//   Check the help index again on the next lookup
+// ----------------------------------------------------------------------------
+{
+    helpsize  = 0;
+    helpindex = 0;
+}
+
+
+bool user_interface::help_index_find(utf8 topic, size_t len,
+                                     uint &topicpos, uint &level)
+// ----------------------------------------------------------------------------
+//   Find a topic using the help index
+// ----------------------------------------------------------------------------
+//   Candidates with the same hash are in the order of the help file, so
+//   the first one that matches is normally the first one checked. Only a
+//   few are kept, which only matters for hash collisions.
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        hash = help_hash(hash, topic[i]);
+
+    uint32_t candidates[HELP_CANDIDATES];
+    uint     found = 0;
+    helpfile.close();
+    {
+        file index(help_index_name(), false);
+        if (index.valid())
+        {
+            // Binary search for the first entry with that hash
+            help_index_entry entry;
+            uint             lo = 0;
+            uint             hi = helpindex;
+            while (lo < hi)
+            {
+                uint mid = (lo + hi) / 2;
+                index.seek(sizeof(help_index_header) + mid * sizeof(entry));
+                if (!index.read((char *) &entry, sizeof(entry)))
+                {
+                    lo = helpindex;
+                    break;
+                }
+                if (entry.hash < hash)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            // Collect candidate headings
+            index.seek(sizeof(help_index_header) + lo * sizeof(entry));
+            for (uint i = lo; i < helpindex && found < HELP_CANDIDATES; i++)
+            {
+                if (!index.read((char *) &entry, sizeof(entry)) ||
+                    entry.hash != hash)
+                    break;
+                candidates[found++] = entry.offset;
+            }
+        }
+    }
+
+    // Check candidate headings in the help file
+    helpfile.open(HELPFILE_NAME);
+    for (uint i = 0; i < found; i++)
+    {
+        helpfile.seek(candidates[i]);
+        if (help_match(topic, len, true, topicpos, level))
+            return true;
+    }
+    return false;
+}
+
 
-    // Look for the topic in the file
+bool user_interface::help_match(utf8 topic, size_t len, bool heading,
+                                uint &topicpos, uint &level)
+// ----------------------------------------------------------------------------
+//   Scan the help file from current position looking for the topic
+// ----------------------------------------------------------------------------
+//   If heading is set, only check the heading at the current position
+{
     int  matching = 0;
-    uint level    = 0;
     bool hadcr    = true;
-    uint topicpos = 0;
+    level         = 0;
 
 #if SIMULATOR
     char debug[80];
     uint debugindex = 0;
 #endif // SIMULATOR
 
-    helpfile.seek(0);
     for (char c = helpfile.getchar(); c; c = helpfile.getchar())
     {
         if (hadcr)
@@ -2352,15 +2954,64 @@ void user_interface::load_help(utf8 topic, size_t len)
             }
         }
         hadcr = c == '\n';
+
+        // When checking a single heading, stop at end of line
+        if (heading && hadcr)
+            break;
+    }
+
+    return uint(matching) == len + 1;
+}
+
+
+void user_interface::load_help(utf8 topic, size_t len)
+// ----------------------------------------------------------------------------
+//   Find the help message associated with the topic
+// ----------------------------------------------------------------------------
+{
+    record(help, "Loading help topic %s", topic);
+
+    if (!len)
+        len = strlen(cstring(topic));
+    command   = nullptr;
+    follow    = false;
+    dirtyHelp = true;
+
+    // Need to have the help file open here
+    if (!helpfile.valid())
+    {
+        helpfile.open(HELPFILE_NAME);
+        if (!helpfile.valid())
+        {
+            help = -1u;
+            line = 0;
+            return;
+        }
+    }
+    dirtyMenu = true;
+
+    // Look for the topic, using the index if we have one
+    uint topicpos = 0;
+    uint level    = 0;
+    bool found    = false;
+    help_index_check();
+    if (helpindex && len)
+    {
+        found = help_index_find(topic, len, topicpos, level);
+    }
+    else
+    {
+        helpfile.seek(0);
+        found = help_match(topic, len, false, topicpos, level);
     }
 
     // Check if we found the topic
-    if (uint(matching) == len + 1)
+    if (found)
     {
         help = topicpos;
         line = 0;
         record(help, "Found topic %s at position %u level %u",
-               topic, helpfile.position(), level);
+               topic, topicpos, level);
 
         if (topics_history >= NUM_TOPICS)
         {
@@ -2444,6 +3095,7 @@ bool user_interface::draw_help()
 
     if (!showing_help())
         return false;
+    EditorLayout.overdrawn();
 
     using p                                    = pattern;
     const style_description styles[NUM_STYLES] =
@@ -175,10 +175,14 @@ struct user_interface
     size_t      insert(size_t offset, utf8 data, size_t len);
     size_t      insert(size_t offset, byte c) { return insert(offset, &c, 1); }
     size_t      remove(size_t offset, size_t len);
+    static void editor_inserted(size_t offset, size_t len);
+    static void editor_removed(size_t offset, size_t len);
+    static void editor_reset();
     result      insert_softkey(int key,
                                cstring before, cstring after,
                                char term = 0);
     void        load_help(utf8 topic, size_t len = 0);
+    void        help_index_invalidate();
 
 protected:
     bool        handle_screen_capture(int key);
@@ -190,6 +194,11 @@ protected:
     bool        handle_digits(int key);
     bool        noHelpForKey(int key);
     bool        do_search(unicode with = 0, bool restart = false);
+    bool        help_match(utf8 topic, size_t len, bool heading,
+                           uint &topicpos, uint &level);
+    void        help_index_check();
+    bool        help_index_find(utf8 topic, size_t len,
+                                uint &topicpos, uint &level);
 
 public:
     int      evaluating;        // Key being evaluated
@@ -258,6 +267,8 @@ protected:
     uint16_t menu_marker[NUM_PLANES][NUM_SOFTKEYS];
     bool     menu_marker_align[NUM_PLANES][NUM_SOFTKEYS];
     file     helpfile;
+    uint     helpsize;          // Size of help file the index was checked for
+    uint     helpindex;         // Number of entries in help index, 0 if none
     friend struct tests;
     friend struct runtime;
 };
@@ -32,12 +32,17 @@
 #include "bignum.h"
 #include "command.h"
 #include "expression.h"
+#include "file.h"
 #include "files.h"
 #include "integer.h"
 #include "list.h"
 #include "locals.h"
 #include "parser.h"
 #include "renderer.h"
+#include "stats.h"
+
+#include <cctype>
+#include <cstdlib>
 
 
 RECORDER(directory,       16, "Directories");
@@ -234,6 +239,9 @@ bool directory::store(object_g name, object_g value)
 
         // Copy new value into storage location
         memmove((byte *) evalue, (byte *) value, vs);
+        directory::index_invalidate();
+        list::index_invalidate();
+        StatsData::sums_invalidate();
 
         // Compute change in size for directories
         delta = vs - es;
@@ -324,6 +332,225 @@ void directory::adjust_sizes(directory_r thisdir, int delta)
 }
 
 
+// ============================================================================
+//
+//   Name index
+//
+// ============================================================================
+//   Large directories get a case-folded hash index of the offsets of their
+//   names, so that recalling a variable does not walk the whole directory.
+//   The index is a side cache in the C heap, because the scratchpad does
+//   not survive between commands, and allocating in runtime memory during
+//   a lookup would move objects the caller may point to. It shares a small
+//   budget with the other side caches. It is rebuilt lazily, forgotten
+//   whenever global objects move (i.e. on store or purge), and released
+//   when the garbage collector runs or another side cache needs memory.
+
+struct directory_index
+// ----------------------------------------------------------------------------
+//   A small number of indexed directories
+// ----------------------------------------------------------------------------
+{
+    enum
+    {
+        SLOTS       = 4,        // Number of directories we remember
+        MIN_ENTRIES = 16,       // Below that, linear search is fine
+        MAX_BUCKETS = 4096,     // Max size of hash table
+        MAX_OFFSET  = 0xFFFF,   // Offsets must fit in a uint16_t
+    };
+
+    struct slot
+    {
+        directory_p dir;        // Directory being indexed
+        uint16_t   *buckets;    // Offset + 1 of name in body, 0 = free
+        uint        mask;       // Number of buckets - 1, 0 = not indexed
+        uint        capacity;   // Number of buckets allocated
+    };
+
+    slot        slots[SLOTS];
+    uint        victim;
+
+    static uint hash(object_p name, size_t size);
+    static bool same(object_p name, size_t ns,
+                     object_p ref, size_t rsize, bool issym);
+    slot *      find(directory_p dir);
+    void        build(slot *s, directory_p dir);
+    void        forget(bool release);
+    static void purge();
+};
+
+static directory_index DirectoryIndex;
+static side_cache      DirectoryCache(directory_index::purge);
+
+
+uint directory_index::hash(object_p name, size_t size)
+// ----------------------------------------------------------------------------
+//   Case-folded FNV-1a hash of a name, consistent with directory comparisons
+// ----------------------------------------------------------------------------
+{
+    byte_p   p = byte_p(name);
+    uint32_t h = 2166136261u;
+    while (size--)
+        h = (h ^ uint32_t(tolower(*p++))) * 16777619u;
+    return h;
+}
+
+
+bool directory_index::same(object_p name, size_t ns,
+                           object_p ref, size_t rsize, bool issym)
+// ----------------------------------------------------------------------------
+//   Check if a name in the directory matches the reference name
+// ----------------------------------------------------------------------------
+{
+    if (name == ref)            // Optimization when name is from directory
+        return true;
+    if (ns != rsize)
+        return false;
+
+    // Regular symbols: case insensitive comparison
+    if (issym)
+        return strncasecmp(cstring(name), cstring(ref), rsize) == 0;
+
+    // Special symbols, e.g. ΣData
+    return memcmp(cstring(name), cstring(ref), rsize) == 0;
+}
+
+
+directory_index::slot *directory_index::find(directory_p dir)
+// ----------------------------------------------------------------------------
+//   Find or build the index for the given directory
+// ----------------------------------------------------------------------------
+{
+    for (uint i = 0; i < SLOTS; i++)
+        if (slots[i].dir == dir)
+            return &slots[i];
+
+    slot *s = &slots[victim++ % SLOTS];
+    build(s, dir);
+    return s;
+}
+
+
+void directory_index::build(slot *s, directory_p dir)
+// ----------------------------------------------------------------------------
+//   Build the hash index for a directory
+// ----------------------------------------------------------------------------
+//   If the directory is too small or too large, or if we run out of memory,
+//   the slot simply records that the directory is not indexed
+{
+    s->dir  = dir;
+    s->mask = 0;
+
+    byte_p body = dir->payload();
+    size_t size = leb128<size_t>(body);
+    if (size > MAX_OFFSET)
+        return;
+
+    // Count entries to size the table
+    byte_p p     = body;
+    size_t left  = size;
+    uint   count = 0;
+    while (left)
+    {
+        object_p name = object_p(p);
+        size_t   ns   = name->size();
+        object_p value = name + ns;
+        size_t   vs    = value->size();
+        if (ns + vs > left)
+            return;             // Malformed directory, let lookup report it
+        p += ns + vs;
+        left -= ns + vs;
+        count++;
+    }
+    if (count < MIN_ENTRIES)
+        return;
+
+    // Keep load factor below 1/2
+    uint buckets = 2 * MIN_ENTRIES;
+    while (buckets < 2 * count)
+        buckets *= 2;
+    if (buckets > MAX_BUCKETS)
+        return;
+    if (buckets > s->capacity)
+    {
+        void *table = DirectoryCache.resize(s->buckets,
+                                            s->capacity * sizeof(uint16_t),
+                                            buckets * sizeof(uint16_t));
+        if (!table)
+            return;
+        s->buckets = (uint16_t *) table;
+        s->capacity = buckets;
+    }
+    memset(s->buckets, 0, buckets * sizeof(uint16_t));
+
+    // Insert names, keeping the first one if there are duplicates
+    uint mask = buckets - 1;
+    p = body;
+    left = size;
+    while (left)
+    {
+        object_p name  = object_p(p);
+        size_t   ns    = name->size();
+        object_p value = name + ns;
+        size_t   vs    = value->size();
+        bool     issym = name->type() == object::ID_symbol;
+        uint     h     = hash(name, ns) & mask;
+        while (uint16_t entry = s->buckets[h])
+        {
+            object_p other = object_p(body + entry - 1);
+            if (same(other, other->size(), name, ns, issym))
+                break;
+            h = (h + 1) & mask;
+        }
+        if (!s->buckets[h])
+            s->buckets[h] = uint16_t(p - body + 1);
+        p += ns + vs;
+        left -= ns + vs;
+    }
+    s->mask = mask;
+    record(directory, "Indexed directory %p, %u entries in %u buckets",
+           dir, count, buckets);
+}
+
+
+void directory_index::forget(bool release)
+// ----------------------------------------------------------------------------
+//   Forget all indexes, and release their memory if requested
+// ----------------------------------------------------------------------------
+{
+    for (uint i = 0; i < SLOTS; i++)
+    {
+        slot *s = &slots[i];
+        s->dir = nullptr;
+        s->mask = 0;
+        if (release)
+        {
+            DirectoryCache.release(s->buckets, s->capacity * sizeof(uint16_t));
+            s->buckets = nullptr;
+            s->capacity = 0;
+        }
+    }
+}
+
+
+void directory_index::purge()
+// ----------------------------------------------------------------------------
+//   Release the memory of all indexes when another side cache needs it
+// ----------------------------------------------------------------------------
+{
+    DirectoryIndex.forget(true);
+}
+
+
+void directory::index_invalidate(bool release)
+// ----------------------------------------------------------------------------
+//   Invalidate the directory name indexes, e.g. when globals move
+// ----------------------------------------------------------------------------
+{
+    DirectoryIndex.forget(release);
+}
+
+
 object_p directory::lookup(object_p ref) const
 // ----------------------------------------------------------------------------
 //   Find if the name exists in the directory, if so return pointer to it
@@ -334,27 +561,31 @@ object_p directory::lookup(object_p ref) const
     size_t rsize = ref->size();
     bool   issym = ref->type() == ID_symbol;
 
-    while (size)
+    // For large directories, use the hash index
+    if (size >= directory_index::MIN_ENTRIES * 4)
     {
-        object_p name = (object_p) p;
-        size_t ns = name->size();
-        if (name == ref)          // Optimization when name is from directory
-            return name;
-        if (ns == rsize)
+        directory_index::slot *s = DirectoryIndex.find(this);
+        if (uint mask = s->mask)
         {
-            if (issym)
-            {
-                // Regular symbols: case insensitive comparison
-                if (strncasecmp(cstring(name), cstring(ref), rsize) == 0)
-                    return name;
-            }
-            else
+            uint h = directory_index::hash(ref, rsize) & mask;
+            while (uint16_t entry = s->buckets[h])
             {
-                // Special symbols, e.g. ΣData
-                if (memcmp(cstring(name), cstring(ref), rsize) == 0)
+                object_p name = object_p(p + entry - 1);
+                if (directory_index::same(name, name->size(),
+                                          ref, rsize, issym))
                     return name;
+                h = (h + 1) & mask;
             }
+            return nullptr;
         }
+    }
+
+    while (size)
+    {
+        object_p name = (object_p) p;
+        size_t ns = name->size();
+        if (directory_index::same(name, ns, ref, rsize, issym))
+            return name;
 
         p += ns;
         object_p value = (object_p) p;
@@ -797,6 +1028,109 @@ COMMAND_BODY(GarbageCollect)
 }
 
 
+COMMAND_BODY(FileSystemCalls)
+// ----------------------------------------------------------------------------
+//   Return the number of filesystem calls made by file operations
+// ----------------------------------------------------------------------------
+{
+    if (rt.args(0))
+        if (integer_p result = integer::make(file::calls()))
+            if (rt.push(result))
+                return OK;
+    return ERROR;
+}
+
+
+COMMAND_BODY(MemoryStatistics)
+// ----------------------------------------------------------------------------
+//   Return memory management counters and the heaviest allocating commands
+// ----------------------------------------------------------------------------
+//   The result is { allocated recycled moved collections gctime { cmds } },
+//   where each command entry is { "name" bytes collections calls }, sorted
+//   by decreasing number of bytes allocated. Entries are named as text, since
+//   evaluated objects may be data types that have no static object.
+{
+    if (!rt.args(0))
+        return ERROR;
+
+    // Copy the counters, since building the result allocates
+    runtime::statistics     stats = rt.stats();
+    runtime::attribution    sorted[runtime::ATTRIBUTIONS];
+    const runtime::attribution *table = rt.attributions();
+    uint count = 0;
+    for (uint i = 0; i < runtime::ATTRIBUTIONS; i++)
+    {
+        if (!table[i].calls)
+            continue;
+        uint j = count++;
+        while (j && sorted[j-1].allocated < table[i].allocated)
+        {
+            sorted[j] = sorted[j-1];
+            j--;
+        }
+        sorted[j] = table[i];
+    }
+
+    scribble scr;
+    size_t values[] =
+    {
+        stats.allocated, stats.recycled, stats.moved,
+        stats.collections, stats.gc_time
+    };
+    for (size_t value : values)
+    {
+        object_g obj = integer::make(value);
+        if (!obj || !rt.append(obj->size(), byte_p(+obj)))
+            return ERROR;
+    }
+
+    list_g cmds;
+    {
+        scribble inner;
+        for (uint i = 0; i < count; i++)
+        {
+            list_g item;
+            {
+                scribble entry;
+                object_g name  = text::make(object::name(id(sorted[i].type)));
+                object_g bytes = integer::make(sorted[i].allocated);
+                object_g gcs   = integer::make(sorted[i].collections);
+                object_g calls = integer::make(sorted[i].calls);
+                if (!name || !bytes || !gcs || !calls                    ||
+                    !rt.append(name->size(), byte_p(+name))             ||
+                    !rt.append(bytes->size(), byte_p(+bytes))           ||
+                    !rt.append(gcs->size(), byte_p(+gcs))               ||
+                    !rt.append(calls->size(), byte_p(+calls)))
+                    return ERROR;
+                item = list::make(ID_list, entry.scratch(), entry.growth());
+            }
+            if (!item || !rt.append(item->size(), byte_p(+item)))
+                return ERROR;
+        }
+        cmds = list::make(ID_list, inner.scratch(), inner.growth());
+    }
+    if (!cmds || !rt.append(cmds->size(), byte_p(+cmds)))
+        return ERROR;
+
+    list_p result = list::make(ID_list, scr.scratch(), scr.growth());
+    if (result && rt.push(result))
+        return OK;
+    return ERROR;
+}
+
+
+COMMAND_BODY(ResetMemoryStatistics)
+// ----------------------------------------------------------------------------
+//   Reset memory management counters and per-command attribution
+// ----------------------------------------------------------------------------
+{
+    if (!rt.args(0))
+        return ERROR;
+    rt.reset_stats();
+    return OK;
+}
+
+
 COMMAND_BODY(FreeMemory)
 // ----------------------------------------------------------------------------
 //   Return amount of free memory (available without garbage collection)
@@ -111,6 +111,11 @@ struct directory : list
     //    Check if a name exists in the directory, return name ptr if it does
     // ------------------------------------------------------------------------
 
+    static void index_invalidate(bool release = false);
+    // ------------------------------------------------------------------------
+    //   Invalidate the name index, e.g. when global objects move
+    // ------------------------------------------------------------------------
+
     size_t purge(object_p name);
     // ------------------------------------------------------------------------
     //   Purge an entry from the directory, return purged size
@@ -190,6 +195,9 @@ COMMAND_DECLARE(Mem);
 COMMAND_DECLARE(FreeMemory);
 COMMAND_DECLARE(SystemMemory);
 COMMAND_DECLARE(GarbageCollect);
+COMMAND_DECLARE(FileSystemCalls);
+COMMAND_DECLARE(MemoryStatistics);
+COMMAND_DECLARE(ResetMemoryStatistics);
 
 COMMAND_DECLARE(home);             // Return to home directory
 COMMAND_DECLARE(CurrentDirectory); // Return the current directory object